@@ -0,0 +1,1150 @@
+#ifndef ADAPTIVE_TRIE__H
+#define ADAPTIVE_TRIE__H
+
+#include <utility>
+#include <optional>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+
+#include "trie_simd.h"
+#include "trie_iterator.h"
+
+/********************************************************
+ * @brief Adaptive radix tree (ART) variant of the generic
+ * trie for byte sized key pieces.
+ *
+ * Nodes come in five layouts, chosen by their number of
+ * children, and are replaced by a bigger or smaller one
+ * whenever emplace or erase moves them past a limit:
+ *
+ *   node0   - no children, every leaf is one
+ *   node4   - up to 4 sorted key bytes and child pointers
+ *   node16  - up to 16 sorted key bytes, searched with SIMD
+ *   node48  - 256 byte index into up to 48 child pointers
+ *   node256 - one child pointer for every byte value
+ *
+ * Children are ordered by their byte value, which is the
+ * key piece shifted so that std::less order is kept for
+ * signed pieces too. The public interface is the one of
+ * trie, iteration visits keys in the same order.
+ ********************************************************/
+template<typename _Key_Piece,
+         typename _Tp,
+         typename _Concat,
+         template <typename> class _Compare = std::less,
+         template <typename,
+                   typename,
+                   typename> class _Key     = std::basic_string,
+         template <typename> class _Traits  = std::char_traits,
+         template <typename> class _Alloc   = std::allocator>
+
+class adaptive_trie
+{
+    static_assert(std::is_integral<_Key_Piece>::value && sizeof(_Key_Piece) == 1,
+                  "adaptive_trie indexes its nodes with byte sized key pieces");
+    static_assert(std::is_same<_Compare<_Key_Piece>, std::less<_Key_Piece>>::value,
+                  "adaptive_trie orders children by their byte value");
+
+protected:
+    struct art_node;
+
+public:
+    class iterator;
+    class const_iterator;
+
+public:
+    /********************************* Member types **********************************/
+    using key_type    = _Key<_Key_Piece, _Traits<_Key_Piece>, _Alloc<_Key_Piece>>;
+    using key_compare = _Compare<_Key_Piece>;
+    using key_concat  = _Concat;
+    using mapped_type = _Tp;
+    using value_type  = std::pair<const key_type, mapped_type&>;
+    using node_type   = art_node;
+    using allocator_type = _Alloc<_Key_Piece>;
+    /*********************************************************************************/
+
+protected:
+    /******************************** Member classes ********************************/
+    enum class node_kind : unsigned char { node0, node4, node16, node48, node256 };
+
+    struct art_node
+    {
+        std::optional<mapped_type> value;
+
+        art_node*      parent = nullptr;
+        node_kind      kind;
+        unsigned char  byte   = 0;   // Key piece leading here from the parent
+        unsigned short count  = 0;   // Number of children
+
+        explicit art_node(node_kind kind) : kind(kind) {}
+    };
+
+    struct node0 : art_node
+    {
+        node0() : art_node(node_kind::node0) {}
+    };
+
+    struct node4 : art_node
+    {
+        unsigned char keys[4]     = {};
+        art_node*     children[4] = {};
+
+        node4() : art_node(node_kind::node4) {}
+    };
+
+    struct node16 : art_node
+    {
+        unsigned char keys[16]     = {};
+        art_node*     children[16] = {};
+
+        node16() : art_node(node_kind::node16) {}
+    };
+
+    struct node48 : art_node
+    {
+        unsigned char slots[256]   = {};   // One past the index of the child in children, 0 if none
+        art_node*     children[48] = {};
+
+        node48() : art_node(node_kind::node48) {}
+    };
+
+    struct node256 : art_node
+    {
+        art_node* children[256] = {};
+
+        node256() : art_node(node_kind::node256) {}
+    };
+
+public:
+    /***************************************** Iterator *******************************************/
+    class iterator
+    {
+        friend class const_iterator;
+        friend class adaptive_trie;
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = adaptive_trie::value_type;
+        using pointer           = arrow_proxy<value_type>;
+        using reference         = value_type;
+
+        explicit iterator(node_type* ptr, const key_concat& concat)
+            :  _pointed_node(ptr), _concat(concat) {}
+
+        iterator(const iterator&)            = default;
+        iterator(iterator&&) noexcept        = default;
+        virtual ~iterator()                  = default;
+
+        reference operator* () const
+        {
+            return value_type(trace_key(_pointed_node, _concat), _pointed_node->value.value());
+        }
+
+        pointer operator->() const
+        {
+            return pointer{value_type(trace_key(_pointed_node, _concat), _pointed_node->value.value())};
+        }
+
+        iterator& operator++()
+        {
+            _pointed_node = const_cast<node_type*>(next_node(_pointed_node));
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator no_op = *this;
+            ++(*this);
+            return no_op;
+        }
+
+        iterator& operator--()
+        {
+            _pointed_node = const_cast<node_type*>(previous_node(_pointed_node));
+            return *this;
+        }
+
+        iterator operator--(int)
+        {
+            iterator no_op = *this;
+            --(*this);
+            return no_op;
+        }
+
+        friend bool operator==(const iterator& lhs, const iterator& rhs) { return lhs._pointed_node == rhs._pointed_node; }
+        friend bool operator!=(const iterator& lhs, const iterator& rhs) { return !(lhs == rhs); }
+
+    private:
+        node_type* _pointed_node;
+        const key_concat& _concat;
+    };
+
+    class const_iterator
+    {
+        friend class adaptive_trie;
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = std::pair<const adaptive_trie::key_type, const mapped_type&>;
+        using pointer           = arrow_proxy<value_type>;
+        using reference         = value_type;
+
+        explicit const_iterator(const node_type* ptr, const key_concat& concat)
+            : _pointed_node(ptr), _concat(concat) {}
+
+        // We are allowing implicit conversion from iterator -> const interator
+        const_iterator(const iterator& it)
+            : _pointed_node(it._pointed_node),
+              _concat(it._concat) {}
+
+        virtual ~const_iterator()                        = default;
+        const_iterator(const const_iterator&)            = default;
+        const_iterator(const_iterator&&) noexcept        = default;
+
+        reference operator* () const
+        {
+            return value_type(trace_key(_pointed_node, _concat), _pointed_node->value.value());
+        }
+
+        pointer operator->() const
+        {
+            return pointer{value_type(trace_key(_pointed_node, _concat), _pointed_node->value.value())};
+        }
+
+        const_iterator& operator++()
+        {
+            _pointed_node = next_node(_pointed_node);
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator no_op = *this;
+            ++(*this);
+            return no_op;
+        }
+
+        const_iterator& operator--()
+        {
+            _pointed_node = previous_node(_pointed_node);
+            return *this;
+        }
+
+        const_iterator operator--(int)
+        {
+            const_iterator no_op = *this;
+            --(*this);
+            return no_op;
+        }
+
+        friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) { return lhs._pointed_node == rhs._pointed_node; }
+        friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs) { return !(lhs == rhs); }
+
+    private:
+        const node_type* _pointed_node;
+        const key_concat& _concat;
+    };
+
+    // ITERATORS
+    iterator begin() noexcept
+    {
+        return empty() ? end() : iterator(const_cast<node_type*>(first_valued(_root)), _key_concat);
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return empty() ? end() : const_iterator(first_valued(_root), _key_concat);
+    }
+
+    iterator       end()          noexcept { return iterator(nullptr, _key_concat);       }
+    const_iterator end()    const noexcept { return const_iterator(nullptr, _key_concat); }
+
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend()   const noexcept { return end();   }
+
+private:
+    /*************************************** Node layouts ******************************************/
+
+    // Byte value of a key piece, keeping the order std::less gives to signed pieces
+    static unsigned char to_byte(const _Key_Piece& key_piece)
+    {
+        return static_cast<unsigned char>(static_cast<int>(key_piece) - std::numeric_limits<_Key_Piece>::min());
+    }
+
+    static _Key_Piece to_piece(unsigned char byte)
+    {
+        return static_cast<_Key_Piece>(byte + std::numeric_limits<_Key_Piece>::min());
+    }
+
+    static size_t capacity(node_kind kind)
+    {
+        switch(kind)
+        {
+            case node_kind::node0:   return 0;
+            case node_kind::node4:   return 4;
+            case node_kind::node16:  return 16;
+            case node_kind::node48:  return 48;
+            case node_kind::node256: return 256;
+        }
+        return 0;
+    }
+
+    // Index of byte among the count sorted keys, count if it's missing
+    static size_t find_key(const unsigned char* keys, size_t count, unsigned char byte)
+    {
+        return std::find(keys, keys + count, byte) - keys;
+    }
+
+    static size_t find_key16(const unsigned char* keys, size_t count, unsigned char byte)
+    {
+#if defined(TRIE_SIMD_SSE2)
+        unsigned match = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys)),
+                                                          _mm_set1_epi8(static_cast<char>(byte))));
+        match &= (1u << count) - 1;
+
+        return (match != 0) ? __builtin_ctz(match) : count;
+#else
+        return find_key(keys, count, byte);
+#endif
+    }
+
+    static art_node* find_child(const art_node* node, unsigned char byte)
+    {
+        switch(node->kind)
+        {
+            case node_kind::node0:
+                return nullptr;
+
+            case node_kind::node4:
+            {
+                auto current = static_cast<const node4*>(node);
+                size_t index = find_key(current->keys, current->count, byte);
+                return (index < current->count) ? current->children[index] : nullptr;
+            }
+
+            case node_kind::node16:
+            {
+                auto current = static_cast<const node16*>(node);
+                size_t index = find_key16(current->keys, current->count, byte);
+                return (index < current->count) ? current->children[index] : nullptr;
+            }
+
+            case node_kind::node48:
+            {
+                auto current = static_cast<const node48*>(node);
+                return (current->slots[byte] != 0) ? current->children[current->slots[byte] - 1] : nullptr;
+            }
+
+            case node_kind::node256:
+                return static_cast<const node256*>(node)->children[byte];
+        }
+        return nullptr;
+    }
+
+    // First child whose byte is not less than from, nullptr if there's none
+    static art_node* child_from(const art_node* node, unsigned from)
+    {
+        switch(node->kind)
+        {
+            case node_kind::node0:
+                return nullptr;
+
+            case node_kind::node4:
+            case node_kind::node16:
+            {
+                const unsigned char* keys     = (node->kind == node_kind::node4) ? static_cast<const node4*>(node)->keys
+                                                                                 : static_cast<const node16*>(node)->keys;
+                art_node* const*     children = (node->kind == node_kind::node4) ? static_cast<const node4*>(node)->children
+                                                                                 : static_cast<const node16*>(node)->children;
+                for(size_t i = 0; i < node->count; ++i)
+                    if(keys[i] >= from)
+                        return children[i];
+
+                return nullptr;
+            }
+
+            case node_kind::node48:
+            {
+                auto current = static_cast<const node48*>(node);
+                for(unsigned byte = from; byte < 256; ++byte)
+                    if(current->slots[byte] != 0)
+                        return current->children[current->slots[byte] - 1];
+
+                return nullptr;
+            }
+
+            case node_kind::node256:
+            {
+                auto current = static_cast<const node256*>(node);
+                for(unsigned byte = from; byte < 256; ++byte)
+                    if(current->children[byte] != nullptr)
+                        return current->children[byte];
+
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    // Last child whose byte is less than until, nullptr if there's none
+    static art_node* child_before(const art_node* node, unsigned until)
+    {
+        switch(node->kind)
+        {
+            case node_kind::node0:
+                return nullptr;
+
+            case node_kind::node4:
+            case node_kind::node16:
+            {
+                const unsigned char* keys     = (node->kind == node_kind::node4) ? static_cast<const node4*>(node)->keys
+                                                                                 : static_cast<const node16*>(node)->keys;
+                art_node* const*     children = (node->kind == node_kind::node4) ? static_cast<const node4*>(node)->children
+                                                                                 : static_cast<const node16*>(node)->children;
+                for(size_t i = node->count; i-- > 0; )
+                    if(keys[i] < until)
+                        return children[i];
+
+                return nullptr;
+            }
+
+            case node_kind::node48:
+            {
+                auto current = static_cast<const node48*>(node);
+                for(unsigned byte = until; byte-- > 0; )
+                    if(current->slots[byte] != 0)
+                        return current->children[current->slots[byte] - 1];
+
+                return nullptr;
+            }
+
+            case node_kind::node256:
+            {
+                auto current = static_cast<const node256*>(node);
+                for(unsigned byte = until; byte-- > 0; )
+                    if(current->children[byte] != nullptr)
+                        return current->children[byte];
+
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    // Sorted insertion into node4 and node16, which have room for it
+    template<typename Node>
+    static void insert_sorted(Node* node, art_node* child)
+    {
+        size_t index = std::upper_bound(node->keys, node->keys + node->count, child->byte) - node->keys;
+
+        std::copy_backward(node->keys + index, node->keys + node->count, node->keys + node->count + 1);
+        std::copy_backward(node->children + index, node->children + node->count, node->children + node->count + 1);
+
+        node->keys[index]     = child->byte;
+        node->children[index] = child;
+    }
+
+    template<typename Node>
+    static void erase_sorted(Node* node, unsigned char byte)
+    {
+        size_t index = find_key(node->keys, node->count, byte);
+
+        std::copy(node->keys + index + 1, node->keys + node->count, node->keys + index);
+        std::copy(node->children + index + 1, node->children + node->count, node->children + index);
+    }
+
+    // Links child into node, which must have room for it
+    static void place_child(art_node* node, art_node* child)
+    {
+        switch(node->kind)
+        {
+            case node_kind::node0:
+                break;
+
+            case node_kind::node4:
+                insert_sorted(static_cast<node4*>(node), child);
+                break;
+
+            case node_kind::node16:
+                insert_sorted(static_cast<node16*>(node), child);
+                break;
+
+            case node_kind::node48:
+            {
+                auto current = static_cast<node48*>(node);
+                current->children[current->count] = child;
+                current->slots[child->byte]      = static_cast<unsigned char>(current->count + 1);
+                break;
+            }
+
+            case node_kind::node256:
+                static_cast<node256*>(node)->children[child->byte] = child;
+                break;
+        }
+
+        ++node->count;
+        child->parent = node;
+    }
+
+    static void unplace_child(art_node* node, unsigned char byte)
+    {
+        switch(node->kind)
+        {
+            case node_kind::node0:
+                break;
+
+            case node_kind::node4:
+                erase_sorted(static_cast<node4*>(node), byte);
+                break;
+
+            case node_kind::node16:
+                erase_sorted(static_cast<node16*>(node), byte);
+                break;
+
+            case node_kind::node48:
+            {
+                // The last child fills the hole so that children stays packed
+                auto   current = static_cast<node48*>(node);
+                size_t index   = current->slots[byte] - 1;
+                size_t last    = current->count - 1;
+
+                current->slots[byte] = 0;
+                if(index != last)
+                {
+                    current->children[index] = current->children[last];
+                    current->slots[current->children[index]->byte] = static_cast<unsigned char>(index + 1);
+                }
+                current->children[last] = nullptr;
+                break;
+            }
+
+            case node_kind::node256:
+                static_cast<node256*>(node)->children[byte] = nullptr;
+                break;
+        }
+
+        --node->count;
+    }
+
+    static void replace_child(art_node* node, unsigned char byte, art_node* child)
+    {
+        switch(node->kind)
+        {
+            case node_kind::node0:
+                break;
+
+            case node_kind::node4:
+            {
+                auto current = static_cast<node4*>(node);
+                current->children[find_key(current->keys, current->count, byte)] = child;
+                break;
+            }
+
+            case node_kind::node16:
+            {
+                auto current = static_cast<node16*>(node);
+                current->children[find_key(current->keys, current->count, byte)] = child;
+                break;
+            }
+
+            case node_kind::node48:
+            {
+                auto current = static_cast<node48*>(node);
+                current->children[current->slots[byte] - 1] = child;
+                break;
+            }
+
+            case node_kind::node256:
+                static_cast<node256*>(node)->children[byte] = child;
+                break;
+        }
+    }
+
+    /*************************************** Traversal ******************************************/
+
+    static const art_node* first_valued(const art_node* current_node)
+    {
+        while(!current_node->value.has_value())
+            current_node = child_from(current_node, 0);
+
+        return current_node;
+    }
+
+    // First valued node after every node below current_node
+    static const art_node* skip_subtree(const art_node* current_node)
+    {
+        for(; current_node->parent != nullptr; current_node = current_node->parent)
+            if(const art_node* sibling = child_from(current_node->parent, current_node->byte + 1u))
+                return first_valued(sibling);
+
+        return nullptr;
+    }
+
+    static const art_node* next_node(const art_node* current_node)
+    {
+        return (current_node->count != 0) ? first_valued(child_from(current_node, 0)) : skip_subtree(current_node);
+    }
+
+    static const art_node* previous_node(const art_node* current_node)
+    {
+        while(current_node->parent != nullptr)
+        {
+            // Rightmost node of the left sibling, which is always a valued leaf
+            if(const art_node* sibling = child_before(current_node->parent, current_node->byte))
+            {
+                while(sibling->count != 0)
+                    sibling = child_before(sibling, 256);
+
+                return sibling;
+            }
+
+            current_node = current_node->parent;
+            if(current_node->value.has_value())
+                return current_node;
+        }
+        return nullptr;
+    }
+
+    static key_type trace_key(const art_node* node, const key_concat& concat)
+    {
+        std::vector<unsigned char> reversed_path;
+        for(const art_node* current_node = node; current_node->parent != nullptr; current_node = current_node->parent)
+            reversed_path.push_back(current_node->byte);
+
+        key_type key;
+        for(auto it = reversed_path.rbegin(); it != reversed_path.rend(); ++it)
+            concat(key, to_piece(*it));
+
+        return key;
+    }
+
+    /*************************************** Node storage ******************************************/
+
+    template<typename Node>
+    Node* allocate_node()
+    {
+        using node_traits = std::allocator_traits<_Alloc<Node>>;
+
+        _Alloc<Node> allocator(_allocator);
+        Node* node = node_traits::allocate(allocator, 1);
+
+        node_traits::construct(allocator, node);
+        return node;
+    }
+
+    template<typename Node>
+    void deallocate_node(Node* node)
+    {
+        using node_traits = std::allocator_traits<_Alloc<Node>>;
+
+        _Alloc<Node> allocator(_allocator);
+        node_traits::destroy(allocator, node);
+        node_traits::deallocate(allocator, node, 1);
+    }
+
+    art_node* create_node(node_kind kind)
+    {
+        switch(kind)
+        {
+            case node_kind::node0:   return allocate_node<node0>();
+            case node_kind::node4:   return allocate_node<node4>();
+            case node_kind::node16:  return allocate_node<node16>();
+            case node_kind::node48:  return allocate_node<node48>();
+            case node_kind::node256: return allocate_node<node256>();
+        }
+        return nullptr;
+    }
+
+    void destroy_node(art_node* node)
+    {
+        switch(node->kind)
+        {
+            case node_kind::node0:   deallocate_node(static_cast<node0*>(node));   break;
+            case node_kind::node4:   deallocate_node(static_cast<node4*>(node));   break;
+            case node_kind::node16:  deallocate_node(static_cast<node16*>(node));  break;
+            case node_kind::node48:  deallocate_node(static_cast<node48*>(node));  break;
+            case node_kind::node256: deallocate_node(static_cast<node256*>(node)); break;
+        }
+    }
+
+    void destroy_subtree(art_node* node)
+    {
+        for(art_node* child = child_from(node, 0); child != nullptr; )
+        {
+            unsigned next = child->byte + 1u;
+
+            destroy_subtree(child);
+            child = child_from(node, next);
+        }
+
+        destroy_node(node);
+    }
+
+    art_node* clone_subtree(const art_node* node)
+    {
+        art_node* copy = create_node(node->kind);
+        copy->byte = node->byte;
+
+        try
+        {
+            copy->value = node->value;
+
+            for(const art_node* child = child_from(node, 0); child != nullptr; child = child_from(node, child->byte + 1u))
+                place_child(copy, clone_subtree(child));
+        }
+        catch(...)
+        {
+            destroy_subtree(copy);
+            throw;
+        }
+        return copy;
+    }
+
+    /********************************************************
+     * @brief Moves node into a new layout of the given
+     * kind, which has room for all of its children, and
+     * links the new node where the old one was.
+     ********************************************************/
+    art_node* resize_node(art_node* node, node_kind kind)
+    {
+        art_node* resized = create_node(kind);
+
+        try
+        {
+            resized->value = std::move(node->value);
+        }
+        catch(...)
+        {
+            destroy_node(resized);
+            throw;
+        }
+        resized->parent = node->parent;
+        resized->byte   = node->byte;
+
+        for(art_node* child = child_from(node, 0); child != nullptr; child = child_from(node, child->byte + 1u))
+            place_child(resized, child);
+
+        if(node->parent != nullptr)
+            replace_child(node->parent, node->byte, resized);
+        else
+            _root = resized;
+
+        destroy_node(node);
+        return resized;
+    }
+
+    // Links child into node, growing it first if it's full
+    void add_child(art_node* node, art_node* child)
+    {
+        if(node->count == capacity(node->kind))
+            node = resize_node(node, static_cast<node_kind>(static_cast<unsigned char>(node->kind) + 1));
+
+        place_child(node, child);
+    }
+
+    // Shrinking is only an optimization, a node that cannot be reallocated keeps its larger layout
+    art_node* shrink_node(art_node* node, node_kind kind) noexcept
+    {
+        try
+        {
+            return resize_node(node, kind);
+        }
+        catch(...)
+        {
+            return node;
+        }
+    }
+
+    /********************************************************
+     * @brief Unlinks the child with byte from node, shrinking
+     * it when it got sparse. An empty node without a value
+     * is left as it is: erase prunes it next, or it is the
+     * root of a trie that was emptied.
+     ********************************************************/
+    art_node* remove_child(art_node* node, unsigned char byte) noexcept
+    {
+        unplace_child(node, byte);
+
+        switch(node->kind)
+        {
+            case node_kind::node4:   return (node->count == 0 && node->value.has_value()) ? shrink_node(node, node_kind::node0) : node;
+            case node_kind::node16:  return (node->count <= 3)  ? shrink_node(node, node_kind::node4)  : node;
+            case node_kind::node48:  return (node->count <= 12) ? shrink_node(node, node_kind::node16) : node;
+            case node_kind::node256: return (node->count <= 40) ? shrink_node(node, node_kind::node48) : node;
+            default:                 return node;
+        }
+    }
+
+    /*************************************** Private Functionality ******************************************/
+
+    const node_type* find_node(const key_type& key) const
+    {
+        const node_type* current_node = _root;
+        for(const auto& key_piece : key)
+        {
+            if(current_node == nullptr)
+                return nullptr;
+
+            current_node = find_child(current_node, to_byte(key_piece));
+        }
+        return current_node;
+    }
+
+    node_type* find_node(const key_type& key)
+    {
+        return const_cast<node_type*>(static_cast<const adaptive_trie*>(this)->find_node(key));
+    }
+
+    bool erase_node(node_type* node)
+    {
+        if(node == nullptr || !node->value.has_value())
+            return false;
+
+        node->value.reset();
+        --_size;
+
+        node_type* current_node = node;
+        while(current_node->count == 0 && !current_node->value.has_value() && current_node->parent != nullptr)
+        {
+            node_type* parent = remove_child(current_node->parent, current_node->byte);
+
+            destroy_node(current_node);
+            current_node = parent;
+        }
+
+        return true;
+    }
+
+public:
+    /********************************* Constructors **********************************/
+    explicit adaptive_trie(const key_concat&     concat,
+                           const key_compare&    compare   = key_compare{},
+                           const allocator_type& allocator = allocator_type{})
+
+        : _size{0}, _key_concat{concat}, _key_compare{compare}, _allocator{allocator}, _root{nullptr}
+    {}
+
+    adaptive_trie(const adaptive_trie& other)
+        : _size{other._size}, _key_concat{other._key_concat}, _key_compare{other._key_compare},
+          _allocator{other._allocator}, _root{nullptr}
+    {
+        if(other._root != nullptr)
+            _root = clone_subtree(other._root);
+    }
+
+    adaptive_trie(adaptive_trie&& other) noexcept
+        : _size{other._size}, _key_concat{std::move(other._key_concat)}, _key_compare{std::move(other._key_compare)},
+          _allocator{other._allocator}, _root{other._root}
+    {
+        other._root = nullptr;
+        other._size = 0;
+    }
+
+    virtual ~adaptive_trie()
+    {
+        if(_root != nullptr)
+            destroy_subtree(_root);
+    }
+
+    /****************************** Assignment operators *****************************/
+
+    adaptive_trie& operator=(adaptive_trie other) noexcept
+    {
+        std::swap(_size,        other._size);
+        std::swap(_key_concat,  other._key_concat);
+        std::swap(_key_compare, other._key_compare);
+        std::swap(_allocator,   other._allocator);
+        std::swap(_root,        other._root);
+
+        return *this;
+    }
+
+    /*********************************************************************************/
+
+    /****************************** Public Functionality *****************************/
+    bool   empty() const noexcept { return _size == 0;  }
+    size_t size()  const noexcept { return _size;       }
+
+    allocator_type get_allocator() const { return _allocator; }
+
+    /***************************************
+     * Invalidates all iterators !!
+    ****************************************/
+    void clear()
+    {
+        if(_root != nullptr)
+            destroy_subtree(_root);
+
+        _root = nullptr;
+        _size = 0;
+    }
+
+    size_t count(const key_type& key) const
+    {
+        return (find(key) == cend()) ? 0 : 1;
+    }
+
+    /***************************************
+     * Invalidates all previous iterators !!
+    ****************************************/
+    template<typename Key, typename Value>
+    std::pair<iterator,bool> emplace(Key&& key, Value&& value)
+    {
+        const key_type local_key(std::forward<Key>(key));
+
+        if(_root == nullptr)
+            _root = create_node(node_kind::node0);
+
+        node_type* current_node = _root;
+        for(const auto& key_piece : local_key)
+        {
+            unsigned char byte = to_byte(key_piece);
+            node_type*   child = find_child(current_node, byte);
+
+            // New branches start out as leaves, their parent grows if it's full
+            if(child == nullptr)
+            {
+                node0* leaf = allocate_node<node0>();
+                leaf->byte  = byte;
+
+                try
+                {
+                    add_child(current_node, leaf);
+                }
+                catch(...)
+                {
+                    deallocate_node(leaf);
+                    throw;
+                }
+                child = leaf;
+            }
+            current_node = child;
+        }
+
+        bool emplaced = false;
+        if(!current_node->value.has_value())
+        {
+            current_node->value.emplace(std::forward<Value>(value));
+            emplaced = true;
+            ++_size;
+        }
+
+        return std::make_pair(iterator(current_node, _key_concat),emplaced);
+    }
+
+    /***************************************
+     * Invalidates all iterators !!
+    ****************************************/
+    size_t erase(const key_type& key)
+    {
+        return (erase_node(find_node(key))) ? 1 : 0;
+    }
+
+    /***************************************
+     * Invalidates all iterators !!
+    ****************************************/
+    void erase(iterator pos)
+    {
+        erase_node(pos._pointed_node);
+    }
+
+    iterator find(const key_type& key)
+    {
+        node_type* target = find_node(key);
+        return (target != nullptr && target->value.has_value()) ? iterator(target, _key_concat) : end();
+    }
+
+    const_iterator find(const key_type& key) const
+    {
+        const node_type* target = find_node(key);
+        return (target != nullptr && target->value.has_value()) ? const_iterator(target, _key_concat) : cend();
+    }
+
+    /***************************************
+     * Looks up every key of [first, last) and
+     * writes one iterator per key to out, end()
+     * for the missing ones.
+    ****************************************/
+    template<typename InputIt, typename OutputIt>
+    OutputIt find_batch(InputIt first, InputIt last, OutputIt out)
+    {
+        for(; first != last; ++first)
+            *out++ = find(*first);
+
+        return out;
+    }
+
+    template<typename InputIt, typename OutputIt>
+    OutputIt find_batch(InputIt first, InputIt last, OutputIt out) const
+    {
+        for(; first != last; ++first)
+            *out++ = find(*first);
+
+        return out;
+    }
+
+    /***************************************
+     * Element with the longest key that is
+     * a prefix of key, end() if there's none.
+    ****************************************/
+    iterator longest_prefix_match(const key_type& key)
+    {
+        const_iterator match = static_cast<const adaptive_trie*>(this)->longest_prefix_match(key);
+        return iterator(const_cast<node_type*>(match._pointed_node), _key_concat);
+    }
+
+    const_iterator longest_prefix_match(const key_type& key) const
+    {
+        const node_type* current_node = _root;
+        const node_type* longest      = nullptr;
+
+        for(auto key_piece = key.begin(); current_node != nullptr; ++key_piece)
+        {
+            if(current_node->value.has_value())
+                longest = current_node;
+
+            if(key_piece == key.end())
+                break;
+
+            current_node = find_child(current_node, to_byte(*key_piece));
+        }
+        return const_iterator(longest, _key_concat);
+    }
+
+    /***************************************
+     * Range of every element whose key
+     * starts with prefix, in key order.
+    ****************************************/
+    std::pair<iterator,iterator> prefix_range(const key_type& prefix)
+    {
+        node_type* subtree = find_node(prefix);
+
+        if(subtree == nullptr || empty())
+            return std::make_pair(end(), end());
+
+        return std::make_pair(iterator(const_cast<node_type*>(first_valued(subtree)), _key_concat),
+                              iterator(const_cast<node_type*>(skip_subtree(subtree)), _key_concat));
+    }
+
+    std::pair<const_iterator,const_iterator> prefix_range(const key_type& prefix) const
+    {
+        const node_type* subtree = find_node(prefix);
+
+        if(subtree == nullptr || empty())
+            return std::make_pair(cend(), cend());
+
+        return std::make_pair(const_iterator(first_valued(subtree), _key_concat),
+                              const_iterator(skip_subtree(subtree), _key_concat));
+    }
+
+    /***************************************
+     * Calls function with the value of every
+     * element whose key starts with prefix,
+     * in key order. Keys are never built.
+    ****************************************/
+    template<typename Function>
+    void for_each_prefix(const key_type& prefix, Function&& function)
+    {
+        node_type* subtree = find_node(prefix);
+
+        if(subtree == nullptr || empty())
+            return;
+
+        for(const node_type *current_node = first_valued(subtree), *last = skip_subtree(subtree);
+            current_node != last; current_node = next_node(current_node))
+            function(const_cast<node_type*>(current_node)->value.value());
+    }
+
+    template<typename Function>
+    void for_each_prefix(const key_type& prefix, Function&& function) const
+    {
+        const node_type* subtree = find_node(prefix);
+
+        if(subtree == nullptr || empty())
+            return;
+
+        for(const node_type *current_node = first_valued(subtree), *last = skip_subtree(subtree);
+            current_node != last; current_node = next_node(current_node))
+            function(std::as_const(current_node->value.value()));
+    }
+
+    mapped_type& at(const key_type& key)
+    {
+        node_type* target = find_node(key);
+
+        if(target != nullptr && target->value.has_value())
+            return target->value.value();
+        else
+            throw std::out_of_range("adaptive_trie::at() was invoked with key that is not stored.");
+    }
+
+    const mapped_type& at(const key_type& key) const
+    {
+        const node_type* target = find_node(key);
+
+        if(target != nullptr && target->value.has_value())
+            return target->value.value();
+        else
+            throw std::out_of_range("adaptive_trie::at() was invoked with key that is not stored.");
+    }
+
+    std::optional<std::reference_wrapper<mapped_type>> operator[](const key_type& key)
+    {
+        node_type* target = find_node(key);
+
+        return (target != nullptr && target->value.has_value())
+                    ? std::optional(std::ref(target->value.value())) : std::nullopt;
+    }
+
+    const std::optional<std::reference_wrapper<const mapped_type>> operator[](const key_type& key) const
+    {
+        const node_type* target = find_node(key);
+
+        return (target != nullptr && target->value.has_value())
+                    ? std::optional(std::cref(target->value.value())) : std::nullopt;
+    }
+
+    // Bytes taken by the nodes, the root included
+    size_t memory_usage() const noexcept
+    {
+        size_t bytes = 0;
+        for(std::vector<const node_type*> pending{_root}; !pending.empty(); )
+        {
+            const node_type* current_node = pending.back();
+            pending.pop_back();
+
+            if(current_node == nullptr)
+                continue;
+
+            switch(current_node->kind)
+            {
+                case node_kind::node0:   bytes += sizeof(node0);   break;
+                case node_kind::node4:   bytes += sizeof(node4);   break;
+                case node_kind::node16:  bytes += sizeof(node16);  break;
+                case node_kind::node48:  bytes += sizeof(node48);  break;
+                case node_kind::node256: bytes += sizeof(node256); break;
+            }
+
+            for(const node_type* child = child_from(current_node, 0); child != nullptr; child = child_from(current_node, child->byte + 1u))
+                pending.push_back(child);
+        }
+        return bytes;
+    }
+
+private:
+
+    size_t _size;
+    key_concat     _key_concat;
+    key_compare    _key_compare;
+    allocator_type _allocator;
+    node_type*     _root;
+};
+
+#endif /* ADAPTIVE_TRIE__H */
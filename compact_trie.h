@@ -0,0 +1,738 @@
+#ifndef COMPACT_TRIE__H
+#define COMPACT_TRIE__H
+
+#include <utility>
+#include <optional>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <iterator>
+#include <limits>
+#include <cstdint>
+#include <array>
+#include <new>
+#include <type_traits>
+
+#include "trie_iterator.h"
+
+/********************************************************
+ * @brief Variant of the generic trie with lean nodes.
+ *
+ * Nodes live in one array and refer to each other by
+ * 32-bit indices. The children of a node are next to
+ * each other in that array, in a block of a power of two
+ * nodes, so a node only stores its parent, its first
+ * child, its number of children, the size class of their
+ * block and its key piece. Full blocks move to a block
+ * twice as big, blocks a quarter full to one half as big,
+ * so toggling a key never moves its siblings every time.
+ * Freed blocks are reused by later blocks of their size.
+ *
+ * Values are kept apart, in a slot per node, and whether
+ * a node holds one is a bit in a bitmap indexed like the
+ * nodes. The bits of siblings are next to each other the
+ * same way the siblings are.
+ *
+ * key_compare is only kept by the trie and nothing is
+ * virtual, so for trie<char, int, ...> a node takes 16
+ * bytes, its value slot 4 and its presence bit.
+ ********************************************************/
+template<typename _Key_Piece,
+         typename _Tp,
+         typename _Concat,
+         template <typename> class _Compare = std::less,
+         template <typename,
+                   typename,
+                   typename> class _Key     = std::basic_string,
+         template <typename> class _Traits  = std::char_traits,
+         template <typename> class _Alloc   = std::allocator>
+
+class compact_trie
+{
+
+protected:
+    struct compact_node;
+    class  value_slots;
+
+public:
+    class iterator;
+    class const_iterator;
+
+public:
+    /********************************* Member types **********************************/
+    using key_type    = _Key<_Key_Piece, _Traits<_Key_Piece>, _Alloc<_Key_Piece>>;
+    using key_compare = _Compare<_Key_Piece>;
+    using key_concat  = _Concat;
+    using mapped_type = _Tp;
+    using value_type  = std::pair<const key_type, mapped_type&>;
+    using node_type   = compact_node;
+    using node_id     = std::uint32_t;
+    using allocator_type = _Alloc<_Key_Piece>;
+    /*********************************************************************************/
+
+protected:
+    static constexpr node_id no_node = std::numeric_limits<node_id>::max();
+
+    /******************************** Member classes ********************************/
+    struct compact_node
+    {
+        node_id    parent;
+        node_id    first_child;  // Children are the child_count nodes from first_child on
+        node_id      child_count;
+        _Key_Piece   key_piece;
+        std::uint8_t block_class;  // The children's block holds 1 << block_class nodes
+    };
+
+    /********************************************************
+     * @brief Optional values of the nodes: raw storage for
+     * one value per node and a bitmap of which slots hold
+     * one. Growing moves only the values that are there.
+     * Both come from the trie's _Alloc.
+     ********************************************************/
+    class value_slots
+    {
+        struct slot
+        {
+            alignas(mapped_type) unsigned char bytes[sizeof(mapped_type)];
+        };
+
+        using slot_traits = std::allocator_traits<_Alloc<slot>>;
+
+    public:
+        using slot_allocator = _Alloc<slot>;
+
+        explicit value_slots(const slot_allocator& allocator)
+            : _allocator(allocator), _bits(_Alloc<std::uint64_t>(allocator))
+        {}
+
+        value_slots(const value_slots& other)
+            : value_slots(slot_traits::select_on_container_copy_construction(other._allocator))
+        {
+            grow(other._capacity);
+            for(size_t index = 0; index < other._capacity; ++index)
+                if(other.has(index))
+                    emplace(index, other.get(index));
+        }
+
+        value_slots(value_slots&& other) noexcept
+            : _allocator(other._allocator), _slots(std::exchange(other._slots, nullptr)),
+              _capacity(std::exchange(other._capacity, 0)), _bits(std::move(other._bits))
+        {}
+
+        value_slots& operator=(value_slots other) noexcept
+        {
+            using std::swap;
+            swap(_allocator, other._allocator);
+            std::swap(_slots, other._slots);
+            std::swap(_capacity, other._capacity);
+            std::swap(_bits, other._bits);
+            return *this;
+        }
+
+        ~value_slots()
+        {
+            clear();
+            if(_slots != nullptr)
+                slot_traits::deallocate(_allocator, _slots, _capacity);
+        }
+
+        slot_allocator get_allocator() const { return _allocator; }
+
+        bool has(size_t index) const noexcept
+        {
+            return (_bits[index / word_bits] >> (index % word_bits)) & 1;
+        }
+
+        mapped_type& get(size_t index) noexcept
+        {
+            return *std::launder(reinterpret_cast<mapped_type*>(&_slots[index]));
+        }
+
+        const mapped_type& get(size_t index) const noexcept
+        {
+            return *std::launder(reinterpret_cast<const mapped_type*>(&_slots[index]));
+        }
+
+        template<typename... Args>
+        void emplace(size_t index, Args&&... args)
+        {
+            ::new(static_cast<void*>(&_slots[index])) mapped_type(std::forward<Args>(args)...);
+            _bits[index / word_bits] |= std::uint64_t{1} << (index % word_bits);
+        }
+
+        void reset(size_t index) noexcept
+        {
+            get(index).~mapped_type();
+            _bits[index / word_bits] &= ~(std::uint64_t{1} << (index % word_bits));
+        }
+
+        // Moves the value of from, if there's one, to the empty slot to
+        void relocate(size_t from, size_t to)
+        {
+            if(!has(from))
+                return;
+
+            emplace(to, std::move(get(from)));
+            reset(from);
+        }
+
+        // Makes room for count slots, doubling the storage at least
+        void grow(size_t count)
+        {
+            if(count <= _capacity)
+                return;
+
+            size_t capacity = std::max(count, 2 * _capacity);
+            value_slots grown(_allocator);
+            grown._slots    = slot_traits::allocate(grown._allocator, capacity);
+            grown._capacity = capacity;
+            grown._bits.assign((capacity + word_bits - 1) / word_bits, 0);
+
+            for(size_t index = 0; index < _capacity; ++index)
+                if(has(index))
+                    grown.emplace(index, std::move(get(index)));
+
+            *this = std::move(grown);
+        }
+
+        void clear() noexcept
+        {
+            for(size_t index = 0; index < _capacity; ++index)
+                if(has(index))
+                    reset(index);
+        }
+
+        size_t memory_usage() const noexcept
+        {
+            return _capacity * sizeof(slot) + _bits.capacity() * sizeof(std::uint64_t);
+        }
+
+    private:
+        static constexpr size_t word_bits = 64;
+
+        slot_allocator                                    _allocator;
+        slot*                                             _slots    = nullptr;
+        size_t                                            _capacity = 0;
+        std::vector<std::uint64_t, _Alloc<std::uint64_t>> _bits;
+    };
+
+public:
+    /***************************************** Iterator *******************************************/
+    class iterator
+    {
+        friend class const_iterator;
+        friend class compact_trie;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = compact_trie::value_type;
+        using pointer           = arrow_proxy<value_type>;
+        using reference         = value_type;
+
+        explicit iterator(compact_trie* trie, node_id node)
+            : _trie(trie), _node(node) {}
+
+        reference operator* () const
+        {
+            return value_type(_trie->trace_key(_node), _trie->_values.get(_node));
+        }
+
+        pointer operator->() const
+        {
+            return pointer{value_type(_trie->trace_key(_node), _trie->_values.get(_node))};
+        }
+
+        iterator& operator++()
+        {
+            _node = _trie->next_node(_node);
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator no_op = *this;
+            ++(*this);
+            return no_op;
+        }
+
+        friend bool operator==(const iterator& lhs, const iterator& rhs) { return lhs._node == rhs._node; }
+        friend bool operator!=(const iterator& lhs, const iterator& rhs) { return !(lhs == rhs); }
+
+    private:
+        compact_trie* _trie;
+        node_id       _node;
+    };
+
+    class const_iterator
+    {
+        friend class compact_trie;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = std::pair<const compact_trie::key_type, const mapped_type&>;
+        using pointer           = arrow_proxy<value_type>;
+        using reference         = value_type;
+
+        explicit const_iterator(const compact_trie* trie, node_id node)
+            : _trie(trie), _node(node) {}
+
+        // We are allowing implicit conversion from iterator -> const interator
+        const_iterator(const iterator& it)
+            : _trie(it._trie), _node(it._node) {}
+
+        reference operator* () const
+        {
+            return value_type(_trie->trace_key(_node), _trie->_values.get(_node));
+        }
+
+        pointer operator->() const
+        {
+            return pointer{value_type(_trie->trace_key(_node), _trie->_values.get(_node))};
+        }
+
+        const_iterator& operator++()
+        {
+            _node = _trie->next_node(_node);
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator no_op = *this;
+            ++(*this);
+            return no_op;
+        }
+
+        friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) { return lhs._node == rhs._node; }
+        friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs) { return !(lhs == rhs); }
+
+    private:
+        const compact_trie* _trie;
+        node_id             _node;
+    };
+
+    // ITERATORS
+    iterator begin() noexcept
+    {
+        return empty() ? end() : iterator(this, first_valued(root));
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return empty() ? end() : const_iterator(this, first_valued(root));
+    }
+
+    iterator       end()          noexcept { return iterator(this, no_node);       }
+    const_iterator end()    const noexcept { return const_iterator(this, no_node); }
+
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend()   const noexcept { return end();   }
+
+private:
+    /*************************************** Private Functionality ******************************************/
+
+    static constexpr node_id root = 0;
+
+    // Blocks of every size a 32-bit index can reach
+    static constexpr size_t block_classes = 33;
+
+    /********************************************************
+     * @brief Block of 1 << block_class nodes, reused from the
+     * free list of its size if there's one. Free blocks are
+     * chained through the parent of their first node.
+     ********************************************************/
+    node_id allocate_block(unsigned block_class)
+    {
+        if(_free_blocks[block_class] != no_node)
+        {
+            node_id block = _free_blocks[block_class];
+            _free_blocks[block_class] = _nodes[block].parent;
+            return block;
+        }
+
+        size_t block_size = size_t{1} << block_class;
+        if(_nodes.size() + block_size > no_node)
+            throw std::length_error("compact_trie ran out of 32-bit node indices.");
+
+        // Values first, so a failing resize of either leaves the trie as it was
+        node_id block = static_cast<node_id>(_nodes.size());
+        _values.grow(_nodes.size() + block_size);
+        _nodes.resize(_nodes.size() + block_size);
+
+        return block;
+    }
+
+    void free_block(node_id block, unsigned block_class) noexcept
+    {
+        _nodes[block].parent = _free_blocks[block_class];
+        _free_blocks[block_class] = block;
+    }
+
+    // Moves node from to the unused index to, its children follow it
+    void move_node(node_id from, node_id to)
+    {
+        _nodes[to] = _nodes[from];
+        _values.relocate(from, to);
+
+        const compact_node& moved = _nodes[to];
+        for(node_id child = moved.first_child; child < moved.first_child + moved.child_count; ++child)
+            _nodes[child].parent = to;
+    }
+
+    /********************************************************
+     * @brief Binary searches the index among the children of
+     * node of the first one whose key piece is not less than
+     * key_piece.
+     ********************************************************/
+    node_id lower_bound_child(node_id node, const _Key_Piece& key_piece) const
+    {
+        const compact_node& parent = _nodes[node];
+        if(parent.child_count == 0)
+            return 0;
+
+        auto first = _nodes.begin() + parent.first_child;
+        auto found = std::lower_bound(first, first + parent.child_count, key_piece,
+                                      [&](const compact_node& child, const _Key_Piece& piece) { return _key_compare(child.key_piece, piece); });
+
+        return static_cast<node_id>(found - first);
+    }
+
+    node_id find_child(node_id node, const _Key_Piece& key_piece) const
+    {
+        node_id index = lower_bound_child(node, key_piece);
+        const compact_node& parent = _nodes[node];
+
+        if(index == parent.child_count || _key_compare(key_piece, _nodes[parent.first_child + index].key_piece))
+            return no_node;
+
+        return parent.first_child + index;
+    }
+
+    // Adds a child with key_piece to node as its index-th child
+    node_id insert_child(node_id node, node_id index, const _Key_Piece& key_piece)
+    {
+        node_id count = _nodes[node].child_count;
+
+        if(count == 0)
+        {
+            _nodes[node].first_child = allocate_block(0);
+            _nodes[node].block_class = 0;
+        }
+        // Full block, the children move to one twice as big leaving room at index
+        else if(count == node_id{1} << _nodes[node].block_class)
+        {
+            unsigned block_class = _nodes[node].block_class;
+            node_id  block       = allocate_block(block_class + 1);
+            node_id  old_block   = _nodes[node].first_child;
+
+            for(node_id child = 0; child < count; ++child)
+                move_node(old_block + child, block + child + (child >= index));
+
+            free_block(old_block, block_class);
+            _nodes[node].first_child = block;
+            _nodes[node].block_class = static_cast<std::uint8_t>(block_class + 1);
+        }
+        else
+        {
+            node_id first = _nodes[node].first_child;
+            for(node_id child = count; child > index; --child)
+                move_node(first + child - 1, first + child);
+        }
+
+        node_id child = _nodes[node].first_child + index;
+        _nodes[child] = compact_node{node, no_node, 0, key_piece, 0};
+        ++_nodes[node].child_count;
+
+        return child;
+    }
+
+    // Removes the index-th child of node, which has neither children nor value
+    void erase_child(node_id node, node_id index)
+    {
+        node_id first = _nodes[node].first_child;
+        node_id count = --_nodes[node].child_count;
+
+        for(node_id child = index; child < count; ++child)
+            move_node(first + child + 1, first + child);
+
+        unsigned block_class = _nodes[node].block_class;
+
+        if(count == 0)
+        {
+            free_block(first, block_class);
+            _nodes[node].first_child = no_node;
+        }
+        // A quarter full the children move to a block half as big, they have to double before moving back
+        else if(block_class > 0 && count <= (node_id{1} << block_class) / 4)
+        {
+            node_id block;
+
+            // Shrinking only saves room, erase must not fail for it
+            try
+            {
+                block = allocate_block(block_class - 1);
+            }
+            catch(...)
+            {
+                return;
+            }
+
+            for(node_id child = 0; child < count; ++child)
+                move_node(first + child, block + child);
+
+            free_block(first, block_class);
+            _nodes[node].first_child = block;
+            _nodes[node].block_class = static_cast<std::uint8_t>(block_class - 1);
+        }
+    }
+
+    node_id first_valued(node_id node) const
+    {
+        // Expanding first child until we have one with value
+        while(!_values.has(node))
+            node = _nodes[node].first_child;
+
+        return node;
+    }
+
+    node_id next_node(node_id node) const
+    {
+        // If node has child we select that branch
+        if(_nodes[node].child_count != 0)
+            return first_valued(_nodes[node].first_child);
+
+        // Going up while we are the last child, siblings are stored next to each other
+        for(node_id parent = _nodes[node].parent; parent != no_node; node = parent, parent = _nodes[node].parent)
+        {
+            if(node + 1 < _nodes[parent].first_child + _nodes[parent].child_count)
+                return first_valued(node + 1);
+        }
+        return no_node;
+    }
+
+    key_type trace_key(node_id node) const
+    {
+        std::vector<_Key_Piece> reversed_key;
+        for(; node != root; node = _nodes[node].parent)
+            reversed_key.push_back(_nodes[node].key_piece);
+
+        key_type key;
+        for(auto it = reversed_key.rbegin(); it != reversed_key.rend(); ++it)
+            _key_concat(key, *it);
+
+        return key;
+    }
+
+    node_id find_node(const key_type& key) const
+    {
+        node_id current_node = root;
+        for(const auto& key_piece : key)
+        {
+            current_node = find_child(current_node, key_piece);
+
+            if(current_node == no_node)
+                return no_node;
+        }
+        return current_node;
+    }
+
+    bool erase_node(node_id node)
+    {
+        if(node == no_node || !_values.has(node))
+            return false;
+
+        _values.reset(node);
+        --_size;
+
+        while(node != root && _nodes[node].child_count == 0 && !_values.has(node))
+        {
+            node_id parent = _nodes[node].parent;
+            erase_child(parent, node - _nodes[parent].first_child);
+            node = parent;
+        }
+
+        return true;
+    }
+
+public:
+    /********************************* Constructors **********************************/
+    explicit compact_trie(const key_concat&     concat,
+                          const key_compare&    compare   = key_compare{},
+                          const allocator_type& allocator = allocator_type{})
+
+        : _size{0}, _key_concat{concat}, _key_compare{compare},
+          _nodes(_Alloc<compact_node>(allocator)), _values(typename value_slots::slot_allocator(allocator))
+    {
+        clear();
+    }
+
+    compact_trie(const compact_trie&)     = default;
+    compact_trie(compact_trie&&) noexcept = default;
+    ~compact_trie()                       = default;
+
+    /****************************** Assignment operators *****************************/
+
+    compact_trie& operator=(const compact_trie& other) = default;
+    compact_trie& operator=(compact_trie&&) noexcept   = default;
+
+    /*********************************************************************************/
+
+    /****************************** Public Functionality *****************************/
+    bool   empty() const noexcept { return _size == 0;  }
+    size_t size()  const noexcept { return _size;       }
+
+    allocator_type get_allocator() const { return allocator_type(_nodes.get_allocator()); }
+
+    /***************************************
+     * Invalidates all iterators !!
+    ****************************************/
+    void clear()
+    {
+        _nodes.assign(1, compact_node{no_node, no_node, 0, _Key_Piece{}, 0});
+        _values = value_slots(_values.get_allocator());
+        _values.grow(1);
+        _free_blocks.fill(no_node);
+        _size = 0;
+    }
+
+    size_t count(const key_type& key) const
+    {
+        return (find(key) == cend()) ? 0 : 1;
+    }
+
+    /***************************************
+     * Invalidates all previous iterators !!
+    ****************************************/
+    template<typename Key, typename Value>
+    std::pair<iterator,bool> emplace(Key&& key, Value&& value)
+    {
+        node_id current_node = root;
+
+        for(const auto& key_piece : key_type(std::forward<Key>(key)))
+        {
+            node_id index = lower_bound_child(current_node, key_piece);
+            node_id count = _nodes[current_node].child_count;
+
+            if(index == count || _key_compare(key_piece, _nodes[_nodes[current_node].first_child + index].key_piece))
+                current_node = insert_child(current_node, index, key_piece);
+            else
+                current_node = _nodes[current_node].first_child + index;
+        }
+
+        bool emplaced = false;
+        if(!_values.has(current_node))
+        {
+            _values.emplace(current_node, std::forward<Value>(value));
+            emplaced = true;
+            ++_size;
+        }
+
+        return std::make_pair(iterator(this, current_node), emplaced);
+    }
+
+    /***************************************
+     * Invalidates all iterators !!
+    ****************************************/
+    size_t erase(const key_type& key)
+    {
+        return (erase_node(find_node(key))) ? 1 : 0;
+    }
+
+    /***************************************
+     * Invalidates all iterators !!
+    ****************************************/
+    void erase(iterator pos)
+    {
+        erase_node(pos._node);
+    }
+
+    iterator find(const key_type& key)
+    {
+        node_id target = find_node(key);
+        return (target != no_node && _values.has(target)) ? iterator(this, target) : end();
+    }
+
+    const_iterator find(const key_type& key) const
+    {
+        node_id target = find_node(key);
+        return (target != no_node && _values.has(target)) ? const_iterator(this, target) : cend();
+    }
+
+    mapped_type& at(const key_type& key)
+    {
+        node_id target = find_node(key);
+
+        if(target != no_node && _values.has(target))
+            return _values.get(target);
+        else
+            throw std::out_of_range("compact_trie::at() was invoked with key that is not stored.");
+    }
+
+    const mapped_type& at(const key_type& key) const
+    {
+        node_id target = find_node(key);
+
+        if(target != no_node && _values.has(target))
+            return _values.get(target);
+        else
+            throw std::out_of_range("compact_trie::at() was invoked with key that is not stored.");
+    }
+
+    std::optional<std::reference_wrapper<mapped_type>> operator[](const key_type& key)
+    {
+        node_id target = find_node(key);
+
+        return (target != no_node && _values.has(target))
+                    ? std::optional(std::ref(_values.get(target))) : std::nullopt;
+    }
+
+    const std::optional<std::reference_wrapper<const mapped_type>> operator[](const key_type& key) const
+    {
+        node_id target = find_node(key);
+
+        return (target != no_node && _values.has(target))
+                    ? std::optional(std::cref(_values.get(target))) : std::nullopt;
+    }
+
+    // Nodes in use, the root included
+    size_t node_count() const noexcept
+    {
+        size_t nodes = 1;
+        for(std::vector<node_id> pending{root}; !pending.empty(); )
+        {
+            const compact_node& current_node = _nodes[pending.back()];
+            pending.pop_back();
+
+            nodes += current_node.child_count;
+            for(node_id child = 0; child < current_node.child_count; ++child)
+                pending.push_back(current_node.first_child + child);
+        }
+        return nodes;
+    }
+
+    /***************************************
+     * Bytes taken by the trie, free blocks
+     * and spare capacity included. Values
+     * count with their size, memory they own
+     * themselves does not.
+    ****************************************/
+    size_t memory_usage() const noexcept
+    {
+        return sizeof(*this) + _nodes.capacity() * sizeof(compact_node) + _values.memory_usage();
+    }
+
+private:
+
+    size_t _size;
+    key_concat  _key_concat;
+    key_compare _key_compare;
+
+    std::vector<compact_node, _Alloc<compact_node>> _nodes;        // The root is node 0
+    value_slots                                     _values;       // Indexed like _nodes
+    std::array<node_id, block_classes>              _free_blocks;  // First free block of each size class
+};
+
+#endif /* COMPACT_TRIE__H */
@@ -0,0 +1,487 @@
+#ifndef CONCURRENT_TRIE__H
+#define CONCURRENT_TRIE__H
+
+#include <utility>
+#include <optional>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <limits>
+#include <cstdint>
+#include <functional>
+
+/********************************************************
+ * @brief Variant of the generic trie that many threads
+ * can read while one thread at a time writes.
+ *
+ * Published nodes are never modified. A writer copies
+ * the nodes on the path of the key it changes, links the
+ * copies to the untouched subtrees and swaps the new
+ * root in atomically, so readers walk either the old or
+ * the new version without taking any lock. Writers are
+ * serialized by a mutex.
+ *
+ * Replaced nodes are reclaimed with epochs: a reader
+ * announces the epoch it started in, a writer tags the
+ * nodes it replaced with the current epoch before moving
+ * it forward, and frees them once every reader still
+ * running started in a later epoch.
+ *
+ * Readers get copies of the values, there are no
+ * iterators into a version that may be reclaimed.
+ ********************************************************/
+template<typename _Key_Piece,
+         typename _Tp,
+         typename _Concat,
+         template <typename> class _Compare = std::less,
+         template <typename,
+                   typename,
+                   typename> class _Key     = std::basic_string,
+         template <typename> class _Traits  = std::char_traits,
+         template <typename> class _Alloc   = std::allocator>
+
+class concurrent_trie
+{
+
+protected:
+    struct cow_node;
+
+public:
+    /********************************* Member types **********************************/
+    using key_type    = _Key<_Key_Piece, _Traits<_Key_Piece>, _Alloc<_Key_Piece>>;
+    using key_compare = _Compare<_Key_Piece>;
+    using key_concat  = _Concat;
+    using mapped_type = _Tp;
+    using node_type   = cow_node;
+    using allocator_type = _Alloc<_Key_Piece>;
+    /*********************************************************************************/
+
+protected:
+    /******************************** Member classes ********************************/
+    struct cow_node
+    {
+        using child_type         = std::pair<_Key_Piece, cow_node*>;
+        using children_allocator = _Alloc<child_type>;
+        using children_type      = std::vector<child_type, children_allocator>;
+
+        std::optional<mapped_type> value;
+        children_type children;   // Sorted by key piece
+
+        explicit cow_node(const children_allocator& allocator)
+            : children(allocator) {}
+    };
+
+    // Epoch announced by one reader, 0 while the slot is free
+    struct alignas(64) reader_slot
+    {
+        std::atomic<std::uint64_t> epoch{0};
+    };
+
+    static constexpr size_t reader_slots = 64;
+
+    /********************************************************
+     * @brief Pins the current epoch for the lifetime of a
+     * read, in the first free slot starting from one
+     * picked by the thread id. Waits for a slot if more
+     * than reader_slots reads are running at once.
+     ********************************************************/
+    class read_guard
+    {
+    public:
+        explicit read_guard(const concurrent_trie& trie)
+        {
+            size_t start = std::hash<std::thread::id>{}(std::this_thread::get_id());
+
+            for(size_t attempt = 0; ; ++attempt)
+            {
+                auto& slot = trie._readers[(start + attempt) % reader_slots].epoch;
+
+                std::uint64_t idle = 0;
+                if(slot.load(std::memory_order_relaxed) == 0 &&
+                   slot.compare_exchange_strong(idle, trie._epoch.load()))
+                {
+                    _slot = &slot;
+                    return;
+                }
+
+                if((attempt + 1) % reader_slots == 0)
+                    std::this_thread::yield();
+            }
+        }
+
+        read_guard(const read_guard&)            = delete;
+        read_guard& operator=(const read_guard&) = delete;
+
+        ~read_guard() { _slot->store(0, std::memory_order_release); }
+
+    private:
+        std::atomic<std::uint64_t>* _slot;
+    };
+
+private:
+    /*************************************** Node storage ******************************************/
+
+    cow_node* create_node()
+    {
+        using node_traits = std::allocator_traits<_Alloc<cow_node>>;
+
+        _Alloc<cow_node> allocator(_allocator);
+        cow_node* node = node_traits::allocate(allocator, 1);
+
+        try
+        {
+            node_traits::construct(allocator, node, typename cow_node::children_allocator(_allocator));
+        }
+        catch(...)
+        {
+            node_traits::deallocate(allocator, node, 1);
+            throw;
+        }
+        return node;
+    }
+
+    cow_node* copy_node(const cow_node* node)
+    {
+        cow_node* copy = create_node();
+
+        try
+        {
+            copy->value    = node->value;
+            copy->children = node->children;
+        }
+        catch(...)
+        {
+            destroy_node(copy);
+            throw;
+        }
+        return copy;
+    }
+
+    void destroy_node(cow_node* node) noexcept
+    {
+        using node_traits = std::allocator_traits<_Alloc<cow_node>>;
+
+        _Alloc<cow_node> allocator(_allocator);
+        node_traits::destroy(allocator, node);
+        node_traits::deallocate(allocator, node, 1);
+    }
+
+    void destroy_subtree(cow_node* node)
+    {
+        for(auto& child : node->children)
+            destroy_subtree(child.second);
+
+        destroy_node(node);
+    }
+
+    /*************************************** Private Functionality ******************************************/
+
+    template<typename Node>
+    auto lower_bound_child(Node& node, const _Key_Piece& key_piece) const
+    {
+        return std::lower_bound(node.children.begin(), node.children.end(), key_piece,
+                                [&](const auto& child, const _Key_Piece& piece) { return _key_compare(child.first, piece); });
+    }
+
+    cow_node* find_child(const cow_node& node, const _Key_Piece& key_piece) const
+    {
+        auto branch = lower_bound_child(node, key_piece);
+
+        return (branch != node.children.end() && !_key_compare(key_piece, branch->first))
+                    ? branch->second : nullptr;
+    }
+
+    // Must be called inside a read_guard, or by the writer
+    const cow_node* find_node(const key_type& key) const
+    {
+        const cow_node* current_node = _root.load();
+        for(const auto& key_piece : key)
+        {
+            current_node = find_child(*current_node, key_piece);
+
+            if(current_node == nullptr)
+                return nullptr;
+        }
+        return current_node;
+    }
+
+    // Nodes on the path of key that exist in the current version, root first
+    std::vector<cow_node*> existing_path(const key_type& key) const
+    {
+        std::vector<cow_node*> path{_root.load()};
+        for(const auto& key_piece : key)
+        {
+            cow_node* child = find_child(*path.back(), key_piece);
+
+            if(child == nullptr)
+                break;
+
+            path.push_back(child);
+        }
+        return path;
+    }
+
+    /********************************************************
+     * @brief Copies the nodes of path, linking each copy to
+     * the next one instead of the original, and publishes
+     * the new root. child is the new version of the node
+     * for key piece path.size() - 1, replacing replaced,
+     * or nullptr if that branch goes away. Every node of
+     * path is retired along with replaced.
+     ********************************************************/
+    void publish_path(const std::vector<cow_node*>& path, const key_type& key, cow_node* child, cow_node* replaced)
+    {
+        std::vector<cow_node*> copies;
+
+        try
+        {
+            for(size_t depth = path.size(); depth-- > 0; )
+            {
+                cow_node* copy = copy_node(path[depth]);
+                copies.push_back(copy);
+
+                auto branch = lower_bound_child(*copy, key[depth]);
+                bool linked = branch != copy->children.end() && !_key_compare(key[depth], branch->first);
+
+                if(child != nullptr && linked)
+                    branch->second = child;
+                else if(child != nullptr)
+                    copy->children.emplace(branch, key[depth], child);
+                else if(linked)
+                    copy->children.erase(branch);
+
+                // Pass-through nodes left without children go away as well, but never the root
+                child = (depth > 0 && copy->children.empty() && !copy->value.has_value()) ? nullptr : copy;
+
+                if(child == nullptr)
+                {
+                    destroy_node(copy);
+                    copies.pop_back();
+                }
+            }
+
+            if(child == nullptr)
+                child = create_node();
+
+            // Retiring must not throw once the new root is out, the callers free child's path when we do
+            _retired.reserve(_retired.size() + path.size() + 1);
+        }
+        catch(...)
+        {
+            for(cow_node* copy : copies)
+                destroy_node(copy);
+            throw;
+        }
+
+        publish_root(path, child, replaced);
+    }
+
+    // Stores root and retires the nodes it replaces, room for them is already reserved
+    void publish_root(const std::vector<cow_node*>& path, cow_node* root, cow_node* replaced) noexcept
+    {
+        _root.store(root);
+
+        std::uint64_t epoch = _epoch.load();
+        for(cow_node* node : path)
+            _retired.emplace_back(epoch, node);
+
+        if(replaced != nullptr)
+            _retired.emplace_back(epoch, replaced);
+
+        _epoch.fetch_add(1);
+        reclaim();
+    }
+
+    // Frees retired nodes no running reader can still see
+    void reclaim() noexcept
+    {
+        std::uint64_t oldest = std::numeric_limits<std::uint64_t>::max();
+        for(const auto& reader : _readers)
+        {
+            std::uint64_t epoch = reader.epoch.load();
+
+            if(epoch != 0)
+                oldest = std::min(oldest, epoch);
+        }
+
+        auto still_visible = std::partition(_retired.begin(), _retired.end(),
+                                            [&](const auto& retired) { return retired.first >= oldest; });
+
+        for(auto it = still_visible; it != _retired.end(); ++it)
+            destroy_node(it->second);
+
+        _retired.erase(still_visible, _retired.end());
+    }
+
+public:
+    /********************************* Constructors **********************************/
+    explicit concurrent_trie(const key_concat&     concat,
+                             const key_compare&    compare   = key_compare{},
+                             const allocator_type& allocator = allocator_type{})
+
+        : _key_concat{concat}, _key_compare{compare}, _allocator{allocator}
+    {
+        _root.store(create_node());
+    }
+
+    concurrent_trie(const concurrent_trie&)            = delete;
+    concurrent_trie& operator=(const concurrent_trie&) = delete;
+
+    virtual ~concurrent_trie()
+    {
+        for(auto& retired : _retired)
+            destroy_node(retired.second);
+
+        destroy_subtree(_root.load());
+    }
+
+    /*********************************************************************************/
+
+    /****************************** Public Functionality *****************************/
+    bool   empty() const noexcept { return size() == 0;  }
+    size_t size()  const noexcept { return _size.load(); }
+
+    allocator_type get_allocator() const { return _allocator; }
+
+    size_t count(const key_type& key) const
+    {
+        read_guard guard(*this);
+
+        const cow_node* target = find_node(key);
+        return (target != nullptr && target->value.has_value()) ? 1 : 0;
+    }
+
+    /***************************************
+     * Copy of the value stored for key, as
+     * seen by the latest published version.
+    ****************************************/
+    std::optional<mapped_type> find(const key_type& key) const
+    {
+        read_guard guard(*this);
+
+        const cow_node* target = find_node(key);
+        return (target != nullptr) ? target->value : std::nullopt;
+    }
+
+    mapped_type at(const key_type& key) const
+    {
+        std::optional<mapped_type> value = find(key);
+
+        if(value.has_value())
+            return std::move(value.value());
+        else
+            throw std::out_of_range("concurrent_trie::at() was invoked with key that is not stored.");
+    }
+
+    /***************************************
+     * Blocks other writers, never readers.
+    ****************************************/
+    template<typename Key, typename Value>
+    bool emplace(Key&& key, Value&& value)
+    {
+        const key_type local_key(std::forward<Key>(key));
+        std::lock_guard<std::mutex> lock(_writer);
+
+        std::vector<cow_node*> path = existing_path(local_key);
+        cow_node* replaced = nullptr;
+
+        if(path.size() == local_key.size() + 1)
+        {
+            if(path.back()->value.has_value())
+                return false;
+
+            replaced = path.back();
+            path.pop_back();
+        }
+
+        // The new version of the key's node, then the missing part of its path bottom up
+        std::vector<cow_node*> created;
+
+        try
+        {
+            cow_node* child = (replaced != nullptr) ? copy_node(replaced) : create_node();
+            created.push_back(child);
+            child->value.emplace(std::forward<Value>(value));
+
+            for(size_t depth = local_key.size(); depth-- > path.size(); )
+            {
+                cow_node* parent = create_node();
+                created.push_back(parent);
+
+                parent->children.emplace_back(local_key[depth], child);
+                child = parent;
+            }
+
+            publish_path(path, local_key, child, replaced);
+        }
+        catch(...)
+        {
+            // Only the new nodes themselves, their children may be shared with the published version
+            for(cow_node* node : created)
+                destroy_node(node);
+            throw;
+        }
+
+        _size.fetch_add(1);
+        return true;
+    }
+
+    /***************************************
+     * Blocks other writers, never readers.
+    ****************************************/
+    size_t erase(const key_type& key)
+    {
+        std::lock_guard<std::mutex> lock(_writer);
+
+        std::vector<cow_node*> path = existing_path(key);
+        if(path.size() != key.size() + 1 || !path.back()->value.has_value())
+            return 0;
+
+        cow_node* replaced = path.back();
+        path.pop_back();
+
+        // Without children the node goes away instead of losing its value
+        cow_node* child = nullptr;
+
+        try
+        {
+            if(!replaced->children.empty())
+            {
+                child = copy_node(replaced);
+                child->value.reset();
+            }
+
+            publish_path(path, key, child, replaced);
+        }
+        catch(...)
+        {
+            if(child != nullptr)
+                destroy_node(child);
+            throw;
+        }
+
+        _size.fetch_sub(1);
+        return 1;
+    }
+
+private:
+
+    key_concat     _key_concat;
+    key_compare    _key_compare;
+    allocator_type _allocator;
+
+    std::atomic<cow_node*>     _root{nullptr};
+    std::atomic<size_t>        _size{0};
+    std::atomic<std::uint64_t> _epoch{1};
+
+    mutable reader_slot _readers[reader_slots];
+
+    std::mutex _writer;
+    std::vector<std::pair<std::uint64_t, cow_node*>> _retired;
+};
+
+#endif /* CONCURRENT_TRIE__H */
@@ -0,0 +1,917 @@
+#ifndef FROZEN_TRIE__H
+#define FROZEN_TRIE__H
+
+#include <cstdint>
+#include <utility>
+#include <optional>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <iterator>
+#include <queue>
+#include <string>
+#include <ostream>
+#include <fstream>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "generic_trie.h"
+
+/********************************************************
+ * @brief Read-only trie built once from a generic trie.
+ *
+ * The shape of the tree is stored as a LOUDS bitvector:
+ * nodes are numbered in breadth-first order and every node
+ * writes a 1 for each of its children followed by a 0.
+ * Siblings therefore get consecutive ids, key pieces live
+ * in one label array indexed by node id and values are
+ * packed into a dense array indexed by the rank of the
+ * node among nodes having a value.
+ *
+ * None of these arrays hold pointers, so save() writes
+ * them to a file as they are and open() serves lookups
+ * and iteration straight from a read-only mapping of it,
+ * shared with every other process mapping the same file.
+ ********************************************************/
+template<typename _Key_Piece,
+         typename _Tp,
+         typename _Concat,
+         template <typename> class _Compare = std::less,
+         template <typename,
+                   typename,
+                   typename> class _Key     = std::basic_string,
+         template <typename> class _Traits  = std::char_traits,
+         template <typename> class _Alloc   = std::allocator>
+
+class frozen_trie
+{
+
+protected:
+    template<typename T> class frozen_array;
+    class bit_vector;
+
+public:
+    class const_iterator;
+
+public:
+    /********************************* Member types **********************************/
+    using source_type = trie<_Key_Piece, _Tp, _Concat, _Compare, _Key, _Traits, _Alloc>;
+    using key_type    = typename source_type::key_type;
+    using key_compare = typename source_type::key_compare;
+    using key_concat  = typename source_type::key_concat;
+    using mapped_type = typename source_type::mapped_type;
+    using value_type  = std::pair<const key_type, const mapped_type&>;
+    using node_id     = size_t;
+    /*********************************************************************************/
+
+    static constexpr node_id npos = static_cast<node_id>(-1);
+
+protected:
+    /******************************** Member classes ********************************/
+
+    /********************************************************
+     * @brief Array that either owns its elements or views
+     * elements owned by a file mapping.
+     ********************************************************/
+    template<typename T>
+    class frozen_array
+    {
+    public:
+        frozen_array() = default;
+
+        explicit frozen_array(std::vector<T>&& owned)
+            : _owned(std::move(owned)), _data(_owned.data()), _size(_owned.size()) {}
+
+        frozen_array(const T* data, size_t size)
+            : _data(data), _size(size) {}
+
+        frozen_array(const frozen_array& other)
+            : _owned(other._owned), _data(other.owns() ? _owned.data() : other._data), _size(other._size) {}
+
+        frozen_array(frozen_array&& other) noexcept
+            : _owned(std::move(other._owned)), _data(other._data), _size(other._size)
+        {
+            other._data = nullptr;
+            other._size = 0;
+        }
+
+        frozen_array& operator=(frozen_array other) noexcept
+        {
+            std::swap(_owned, other._owned);
+            std::swap(_data,  other._data);
+            std::swap(_size,  other._size);
+            return *this;
+        }
+
+        const T& operator[](size_t pos) const { return _data[pos]; }
+
+        const T* begin() const noexcept { return _data;         }
+        const T* end()   const noexcept { return _data + _size; }
+        const T* data()  const noexcept { return _data;         }
+
+        size_t size() const noexcept { return _size; }
+
+        // Heap bytes, nothing for a view into a mapping
+        size_t memory_usage() const noexcept { return _owned.capacity() * sizeof(T); }
+
+    private:
+        bool owns() const noexcept { return !_owned.empty(); }
+
+        std::vector<T> _owned;
+        const T*       _data = nullptr;
+        size_t         _size = 0;
+    };
+
+    class bit_vector
+    {
+    public:
+        bit_vector() = default;
+
+        // View of a bitvector and its index saved by for_each_array
+        bit_vector(frozen_array<std::uint64_t> words,
+                   frozen_array<std::uint64_t> block_ranks,
+                   frozen_array<std::uint64_t> select0_samples,
+                   frozen_array<std::uint64_t> select1_samples,
+                   std::uint64_t size)
+
+            : _words(std::move(words)), _block_ranks(std::move(block_ranks)),
+              _select0_samples(std::move(select0_samples)), _select1_samples(std::move(select1_samples)),
+              _size(size)
+        {}
+
+        void push_back(bool bit)
+        {
+            if(_size % word_bits == 0)
+                _pending.push_back(0);
+
+            if(bit)
+                _pending.back() |= std::uint64_t{1} << (_size % word_bits);
+
+            ++_size;
+        }
+
+        bool operator[](size_t pos) const
+        {
+            return (_words[pos / word_bits] >> (pos % word_bits)) & 1;
+        }
+
+        size_t size() const noexcept { return _size; }
+
+        /****************************************************
+         * Has to be called once every bit has been pushed,
+         * rank and select are undefined before that.
+         ****************************************************/
+        void build_index()
+        {
+            std::vector<std::uint64_t> block_ranks(1, 0);
+            std::vector<std::uint64_t> select0_samples;
+            std::vector<std::uint64_t> select1_samples;
+
+            std::uint64_t ones = 0;
+            for(size_t word = 0; word < _pending.size(); ++word)
+            {
+                ones += popcount(_pending[word]);
+
+                if((word + 1) % block_words == 0 || word + 1 == _pending.size())
+                    block_ranks.push_back(ones);
+            }
+
+            // Every sample_rate-th bit of both kinds remembers its block,
+            // so select only binary searches between two samples
+            for(size_t block = 0; block + 1 < block_ranks.size(); ++block)
+            {
+                std::uint64_t ones_after  = block_ranks[block + 1];
+                std::uint64_t zeros_after = std::min<std::uint64_t>((block + 1) * block_bits, _size) - ones_after;
+
+                while(select1_samples.size() * sample_rate < ones_after)
+                    select1_samples.push_back(block);
+
+                while(select0_samples.size() * sample_rate < zeros_after)
+                    select0_samples.push_back(block);
+            }
+
+            _pending.shrink_to_fit();
+            _words           = frozen_array<std::uint64_t>(std::move(_pending));
+            _block_ranks     = frozen_array<std::uint64_t>(std::move(block_ranks));
+            _select0_samples = frozen_array<std::uint64_t>(std::move(select0_samples));
+            _select1_samples = frozen_array<std::uint64_t>(std::move(select1_samples));
+            _pending         = std::vector<std::uint64_t>();
+        }
+
+        // Arrays making up the bitvector and its index, in the order the view constructor takes them
+        template<typename Function>
+        void for_each_array(Function&& function) const
+        {
+            function(_words);
+            function(_block_ranks);
+            function(_select0_samples);
+            function(_select1_samples);
+        }
+
+        // Number of 1 bits in [0, pos)
+        size_t rank1(size_t pos) const
+        {
+            size_t block = pos / block_bits;
+            size_t rank  = _block_ranks[block];
+
+            for(size_t word = block * block_words; word < pos / word_bits; ++word)
+                rank += popcount(_words[word]);
+
+            if(pos % word_bits != 0)
+                rank += popcount(_words[pos / word_bits] & ((std::uint64_t{1} << (pos % word_bits)) - 1));
+
+            return rank;
+        }
+
+        size_t rank0(size_t pos) const { return pos - rank1(pos); }
+
+        // Position of the n-th (0 based) 1 bit
+        size_t select1(size_t n) const { return select<true>(n); }
+
+        // Position of the n-th (0 based) 0 bit
+        size_t select0(size_t n) const { return select<false>(n); }
+
+        // Position of the first 0 bit at or after pos
+        size_t next0(size_t pos) const
+        {
+            size_t        word = pos / word_bits;
+            std::uint64_t bits = ~_words[word] & (~std::uint64_t{0} << (pos % word_bits));
+
+            while(bits == 0)
+                bits = ~_words[++word];
+
+            return word * word_bits + select_in_word(bits, 0);
+        }
+
+        /****************************************************
+         * Whether a view built from a file holds together:
+         * enough words for the bits, a rank per block, ranks
+         * that only grow and never by more than a block, and
+         * samples for every bit of both kinds that point into
+         * the blocks. The words themselves are not read, so
+         * opening stays lazy.
+         ****************************************************/
+        bool well_formed() const noexcept
+        {
+            size_t blocks = (_words.size() + block_words - 1) / block_words;
+
+            if(_words.size() != (_size + word_bits - 1) / word_bits || _block_ranks.size() != blocks + 1 ||
+               _block_ranks[0] != 0)
+                return false;
+
+            for(size_t block = 0; block < blocks; ++block)
+            {
+                if(_block_ranks[block + 1] < _block_ranks[block] || _block_ranks[block + 1] - _block_ranks[block] > block_bits)
+                    return false;
+            }
+
+            std::uint64_t ones = _block_ranks[blocks];
+            if(ones > _size ||
+               _select1_samples.size() != (ones + sample_rate - 1) / sample_rate ||
+               _select0_samples.size() != (_size - ones + sample_rate - 1) / sample_rate)
+                return false;
+
+            auto in_blocks = [&](std::uint64_t sample) { return sample < blocks; };
+            return std::all_of(_select0_samples.begin(), _select0_samples.end(), in_blocks) &&
+                   std::all_of(_select1_samples.begin(), _select1_samples.end(), in_blocks);
+        }
+
+        // Number of 1 bits, once the index is built
+        size_t count1() const noexcept { return _block_ranks[_block_ranks.size() - 1]; }
+
+        size_t memory_usage() const noexcept
+        {
+            return sizeof(*this) + _words.memory_usage() + _block_ranks.memory_usage()
+                                 + _select0_samples.memory_usage() + _select1_samples.memory_usage();
+        }
+
+    private:
+        static constexpr size_t word_bits   = 64;
+        static constexpr size_t block_words = 8;
+        static constexpr size_t block_bits  = word_bits * block_words;
+        static constexpr size_t sample_rate = 512;
+
+        static size_t popcount(std::uint64_t word)
+        {
+        #if defined(__GNUC__) || defined(__clang__)
+            return static_cast<size_t>(__builtin_popcountll(word));
+        #else
+            size_t count = 0;
+            for(; word != 0; word &= word - 1)
+                ++count;
+            return count;
+        #endif
+        }
+
+        static size_t select_in_word(std::uint64_t word, size_t n)
+        {
+            for(; n > 0; --n)
+                word &= word - 1;
+
+        #if defined(__GNUC__) || defined(__clang__)
+            return static_cast<size_t>(__builtin_ctzll(word));
+        #else
+            size_t pos = 0;
+            for(; (word & 1) == 0; word >>= 1)
+                ++pos;
+            return pos;
+        #endif
+        }
+
+        // Bits of the given kind in front of block
+        template<bool Bit>
+        size_t block_rank(size_t block) const
+        {
+            return Bit ? _block_ranks[block] : block * block_bits - _block_ranks[block];
+        }
+
+        template<bool Bit>
+        size_t select(size_t n) const
+        {
+            const frozen_array<std::uint64_t>& samples = Bit ? _select1_samples : _select0_samples;
+
+            // Last block whose rank is not greater than n
+            size_t low  = samples[n / sample_rate];
+            size_t high = (n / sample_rate + 1 < samples.size()) ? samples[n / sample_rate + 1] + 1
+                                                                 : _block_ranks.size() - 1;
+            while(high - low > 1)
+            {
+                size_t middle = low + (high - low) / 2;
+                if(block_rank<Bit>(middle) <= n)
+                    low = middle;
+                else
+                    high = middle;
+            }
+
+            n -= block_rank<Bit>(low);
+            for(size_t word = low * block_words; ; ++word)
+            {
+                std::uint64_t bits  = Bit ? _words[word] : ~_words[word];
+                size_t        count = popcount(bits);
+
+                if(n < count)
+                    return word * word_bits + select_in_word(bits, n);
+
+                n -= count;
+            }
+        }
+
+        std::vector<std::uint64_t>  _pending;   // Bits pushed before build_index
+        frozen_array<std::uint64_t> _words;
+        frozen_array<std::uint64_t> _block_ranks;
+        frozen_array<std::uint64_t> _select0_samples;
+        frozen_array<std::uint64_t> _select1_samples;
+        std::uint64_t               _size = 0;
+    };
+
+    /********************************************************
+     * @brief Start of a file written by save(). Every array
+     * follows as a section, aligned to section_alignment,
+     * in the byte order of the machine that wrote it.
+     ********************************************************/
+    static constexpr size_t section_count     = 10;
+    static constexpr size_t section_alignment = 64;
+
+    struct file_header
+    {
+        char          magic[8];
+        std::uint32_t byte_order;
+        std::uint32_t key_piece_size;
+        std::uint32_t mapped_size;
+        std::uint32_t reserved;
+        std::uint64_t size;
+        std::uint64_t louds_bits;
+        std::uint64_t has_value_bits;
+        std::uint64_t section_offsets[section_count];
+        std::uint64_t section_lengths[section_count];   // In elements
+    };
+
+    static constexpr char          file_magic[8]   = {'F', 'R', 'Z', 'T', 'R', 'I', 'E', '1'};
+    static constexpr std::uint32_t file_byte_order = 0x01020304;
+
+public:
+    /***************************************** Iterator *******************************************/
+    class const_iterator
+    {
+        friend class frozen_trie;
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = frozen_trie::value_type;
+        using pointer           = arrow_proxy<value_type>;
+        using reference         = value_type;
+
+        explicit const_iterator(const frozen_trie* trie, node_id node)
+            : _trie(trie), _node(node) {}
+
+        const_iterator(const const_iterator&)            = default;
+        const_iterator(const_iterator&&) noexcept        = default;
+        virtual ~const_iterator()                        = default;
+
+        const_iterator& operator=(const const_iterator&)     = default;
+        const_iterator& operator=(const_iterator&&) noexcept = default;
+
+        reference operator* () const
+        {
+            return value_type(_trie->trace_key(_node), _trie->value_of(_node));
+        }
+
+        pointer operator->() const
+        {
+            return pointer{value_type(_trie->trace_key(_node), _trie->value_of(_node))};
+        }
+
+        const_iterator& operator++()
+        {
+            _node = _trie->next_node(_node);
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator no_op = *this;
+            ++(*this);
+            return no_op;
+        }
+
+        const_iterator& operator--()
+        {
+            _node = _trie->previous_node(_node);
+            return *this;
+        }
+
+        const_iterator operator--(int)
+        {
+            const_iterator no_op = *this;
+            --(*this);
+            return no_op;
+        }
+
+        friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) { return lhs._node == rhs._node; }
+        friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs) { return !(lhs == rhs); }
+
+    private:
+        const frozen_trie* _trie;
+        node_id _node;
+    };
+
+    using iterator = const_iterator;
+
+    // ITERATORS
+    const_iterator begin() const noexcept
+    {
+        return (_size == 0) ? end() : const_iterator(this, first_valued(0));
+    }
+
+    const_iterator end()    const noexcept { return const_iterator(this, npos); }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend()   const noexcept { return end();   }
+
+private:
+    /*************************************** Private Functionality ******************************************/
+
+    // First child and number of children of node
+    std::pair<node_id, size_t> children(node_id node) const
+    {
+        size_t block_begin = (node == 0) ? 0 : _louds.select0(node - 1) + 1;
+        size_t block_end   = _louds.next0(block_begin);
+
+        // Every 1 before block_begin introduced one of the nodes 1..
+        return { block_begin - node + 1, block_end - block_begin };
+    }
+
+    node_id parent(node_id node) const
+    {
+        return _louds.select1(node - 1) - (node - 1);
+    }
+
+    const _Key_Piece& label(node_id node) const { return _labels[node - 1]; }
+
+    bool has_value(node_id node) const { return _has_value[node]; }
+
+    const mapped_type& value_of(node_id node) const { return _values[_has_value.rank1(node)]; }
+
+    node_id first_valued(node_id node) const
+    {
+        while(!has_value(node))
+            node = children(node).first;
+
+        return node;
+    }
+
+    node_id next_node(node_id node) const
+    {
+        auto [first_child, child_count] = children(node);
+
+        if(child_count != 0)
+            return first_valued(first_child);
+
+        return skip_subtree(node);
+    }
+
+    // First valued node after every node below node
+    node_id skip_subtree(node_id node) const
+    {
+        // Going up while we are the last child, siblings have consecutive ids
+        while(node != 0)
+        {
+            auto [first_sibling, sibling_count] = children(parent(node));
+
+            if(node + 1 < first_sibling + sibling_count)
+                return first_valued(node + 1);
+
+            node = parent(node);
+        }
+        return npos;
+    }
+
+    node_id previous_node(node_id node) const
+    {
+        if(node == 0 || node == npos)
+            return npos;
+
+        // Moving up while we are the first child
+        while(node == children(parent(node)).first)
+        {
+            node = parent(node);
+
+            if(has_value(node))
+                return node;
+
+            if(node == 0)
+                return npos;
+        }
+
+        // Rightmost node of left sibling
+        node = node - 1;
+        for(auto range = children(node); range.second != 0; range = children(node))
+            node = range.first + range.second - 1;
+
+        return node;
+    }
+
+    key_type trace_key(node_id node) const
+    {
+        std::vector<node_id> reversed_path;
+        for(; node != 0; node = parent(node))
+            reversed_path.push_back(node);
+
+        key_type key;
+        for(auto it = reversed_path.rbegin(); it != reversed_path.rend(); ++it)
+            _key_concat(key, label(*it));
+
+        return key;
+    }
+
+    node_id find_node(const key_type& key) const
+    {
+        node_id current_node = 0;
+        for(const auto& key_piece : key)
+        {
+            auto [first_child, child_count] = children(current_node);
+
+            auto labels_begin = _labels.begin() + (first_child - 1);
+            auto labels_end   = labels_begin + child_count;
+            auto branch = std::lower_bound(labels_begin, labels_end, key_piece, _key_compare);
+
+            if(branch == labels_end || _key_compare(key_piece, *branch))
+                return npos;
+
+            current_node = first_child + (branch - labels_begin);
+        }
+        return current_node;
+    }
+
+    node_id find_valued(const key_type& key) const
+    {
+        node_id target = find_node(key);
+        return (target != npos && has_value(target)) ? target : npos;
+    }
+
+    // Read-only mapping of a whole file, unmapped with the last array viewing it
+    static std::pair<std::shared_ptr<const void>, size_t> map_file(const std::string& path)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if(descriptor < 0)
+            throw std::runtime_error("frozen_trie::open() could not open " + path);
+
+        struct stat status;
+        if(::fstat(descriptor, &status) != 0 || status.st_size == 0)
+        {
+            ::close(descriptor);
+            throw std::runtime_error("frozen_trie::open() could not map " + path);
+        }
+
+        size_t length = static_cast<size_t>(status.st_size);
+        void*  data   = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, descriptor, 0);
+        ::close(descriptor);
+
+        if(data == MAP_FAILED)
+            throw std::runtime_error("frozen_trie::open() could not map " + path);
+
+        return { std::shared_ptr<const void>(data, [length](const void* mapped) { ::munmap(const_cast<void*>(mapped), length); }),
+                 length };
+#else
+        // Without mmap the file is read into one aligned buffer instead
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if(!in)
+            throw std::runtime_error("frozen_trie::open() could not open " + path);
+
+        size_t length = static_cast<size_t>(in.tellg());
+        auto   buffer = std::make_shared<std::vector<std::uint64_t>>((length + 7) / 8);
+
+        in.seekg(0);
+        if(!in.read(reinterpret_cast<char*>(buffer->data()), length))
+            throw std::runtime_error("frozen_trie::open() could not read " + path);
+
+        return { std::shared_ptr<const void>(buffer, buffer->data()), length };
+#endif
+    }
+
+    // Arrays in the order their sections are written
+    template<typename Function>
+    void for_each_array(Function&& function) const
+    {
+        _louds.for_each_array(function);
+        _has_value.for_each_array(function);
+        function(_labels);
+        function(_values);
+    }
+
+    explicit frozen_trie(const key_concat& concat, const key_compare& compare)
+        : _size{0}, _key_concat{concat}, _key_compare{compare}
+    {}
+
+public:
+    /********************************* Constructors **********************************/
+    // Tries counting their work with a _Counters policy freeze the same way
+    template<typename _Counters>
+    explicit frozen_trie(const trie<_Key_Piece, _Tp, _Concat, _Compare, _Key, _Traits, _Alloc, _Counters>& source)
+        : _size{source._size}, _key_concat{source._key_concat}, _key_compare{source._key_compare}
+    {
+        using source_node = typename std::decay_t<decltype(source)>::node_type;
+
+        std::vector<_Key_Piece>  labels;
+        std::vector<mapped_type> values;
+        labels.reserve(source._size);
+        values.reserve(source._size);
+
+        // Breadth-first numbering keeps the children of a node next to each other
+        std::queue<const source_node*> pending;
+        pending.push(&source._root);
+
+        while(!pending.empty())
+        {
+            const source_node* node = pending.front();
+            pending.pop();
+
+            for(const auto& child : node->children)
+            {
+                _louds.push_back(true);
+                labels.push_back(child.key_piece);
+                pending.push(&child);
+            }
+            _louds.push_back(false);
+
+            _has_value.push_back(node->value.has_value());
+            if(node->value.has_value())
+                values.push_back(node->value.value());
+        }
+
+        _louds.build_index();
+        _has_value.build_index();
+
+        labels.shrink_to_fit();
+        values.shrink_to_fit();
+        _labels = frozen_array<_Key_Piece>(std::move(labels));
+        _values = frozen_array<mapped_type>(std::move(values));
+    }
+
+    frozen_trie(const frozen_trie&)     = default;
+    frozen_trie(frozen_trie&&) noexcept = default;
+    virtual ~frozen_trie()              = default;
+
+    /****************************** Assignment operators *****************************/
+
+    frozen_trie& operator=(const frozen_trie&)     = default;
+    frozen_trie& operator=(frozen_trie&&) noexcept = default;
+
+    /*********************************************************************************/
+
+    /****************************** Public Functionality *****************************/
+    bool   empty() const noexcept { return _size == 0;  }
+    size_t size()  const noexcept { return _size;       }
+
+    // Bytes owned by the frozen representation, a file mapping is not counted
+    size_t memory_usage() const noexcept
+    {
+        return sizeof(*this) + _louds.memory_usage() + _has_value.memory_usage()
+                             + _labels.memory_usage() + _values.memory_usage();
+    }
+
+    /***************************************
+     * Writes every array to out as it is,
+     * for open() to map. Key pieces and
+     * values have to be trivially copyable.
+    ****************************************/
+    void save(std::ostream& out) const
+    {
+        static_assert(std::is_trivially_copyable<_Key_Piece>::value && std::is_trivially_copyable<mapped_type>::value,
+                      "frozen_trie::save() writes key pieces and values as raw bytes");
+
+        file_header header{};
+        std::memcpy(header.magic, file_magic, sizeof(file_magic));
+        header.byte_order     = file_byte_order;
+        header.key_piece_size = sizeof(_Key_Piece);
+        header.mapped_size    = sizeof(mapped_type);
+        header.size           = _size;
+        header.louds_bits     = _louds.size();
+        header.has_value_bits = _has_value.size();
+
+        std::vector<std::pair<const char*, size_t>> sections;
+        for_each_array([&](const auto& array)
+        {
+            sections.emplace_back(reinterpret_cast<const char*>(array.data()), array.size() * sizeof(array[0]));
+        });
+
+        std::uint64_t offset = sizeof(file_header);
+        for(size_t section = 0; section < section_count; ++section)
+        {
+            offset = (offset + section_alignment - 1) / section_alignment * section_alignment;
+
+            header.section_offsets[section] = offset;
+            offset += sections[section].second;
+        }
+
+        size_t i = 0;
+        for_each_array([&](const auto& array) { header.section_lengths[i++] = array.size(); });
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        const char padding[section_alignment] = {};
+        std::uint64_t written = sizeof(file_header);
+        for(size_t section = 0; section < section_count; ++section)
+        {
+            out.write(padding, header.section_offsets[section] - written);
+            out.write(sections[section].first, sections[section].second);
+            written = header.section_offsets[section] + sections[section].second;
+        }
+
+        if(!out)
+            throw std::runtime_error("frozen_trie::save() could not write the trie.");
+    }
+
+    /***************************************
+     * Frozen trie served from a read-only
+     * mapping of a file written by save(),
+     * nothing is copied or deserialized.
+    ****************************************/
+    static frozen_trie open(const std::string& path, const key_concat& concat, const key_compare& compare = key_compare{})
+    {
+        static_assert(std::is_trivially_copyable<_Key_Piece>::value && std::is_trivially_copyable<mapped_type>::value,
+                      "frozen_trie::open() reads key pieces and values as raw bytes");
+
+        auto [mapping, length] = map_file(path);
+        const char* base = static_cast<const char*>(mapping.get());
+
+        file_header header;
+        if(length < sizeof(header))
+            throw std::runtime_error("frozen_trie::open() found no frozen trie in " + path);
+
+        std::memcpy(&header, base, sizeof(header));
+        if(std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 || header.byte_order != file_byte_order ||
+           header.key_piece_size != sizeof(_Key_Piece) || header.mapped_size != sizeof(mapped_type))
+            throw std::runtime_error("frozen_trie::open() found an incompatible frozen trie in " + path);
+
+        size_t section = 0;
+        auto view = [&](auto element) -> frozen_array<decltype(element)>
+        {
+            using T = decltype(element);
+
+            std::uint64_t offset = header.section_offsets[section];
+            std::uint64_t count  = header.section_lengths[section++];
+
+            if(offset % alignof(T) != 0 || offset > length || count > (length - offset) / sizeof(T))
+                throw std::runtime_error("frozen_trie::open() found a truncated frozen trie in " + path);
+
+            return frozen_array<T>(reinterpret_cast<const T*>(base + offset), count);
+        };
+
+        frozen_trie frozen(concat, compare);
+        frozen._size = header.size;
+
+        // Function arguments are evaluated in any order, the sections must be read in file order
+        auto louds_words   = view(std::uint64_t{});
+        auto louds_ranks   = view(std::uint64_t{});
+        auto louds_select0 = view(std::uint64_t{});
+        auto louds_select1 = view(std::uint64_t{});
+        frozen._louds = bit_vector(std::move(louds_words), std::move(louds_ranks),
+                                   std::move(louds_select0), std::move(louds_select1), header.louds_bits);
+
+        auto value_words   = view(std::uint64_t{});
+        auto value_ranks   = view(std::uint64_t{});
+        auto value_select0 = view(std::uint64_t{});
+        auto value_select1 = view(std::uint64_t{});
+        frozen._has_value = bit_vector(std::move(value_words), std::move(value_ranks),
+                                       std::move(value_select0), std::move(value_select1), header.has_value_bits);
+
+        frozen._labels  = view(_Key_Piece{});
+        frozen._values  = view(mapped_type{});
+
+        // Every node has a 0 in louds and a bit in has_value, every node but the root a 1 and a label
+        if(!frozen._louds.well_formed() || !frozen._has_value.well_formed() ||
+           header.has_value_bits != header.louds_bits - frozen._louds.count1() ||
+           frozen._labels.size() != frozen._louds.count1() || frozen._labels.size() + 1 != header.has_value_bits ||
+           frozen._values.size() != header.size || frozen._has_value.count1() != header.size)
+            throw std::runtime_error("frozen_trie::open() found a corrupt frozen trie in " + path);
+
+        frozen._mapping = std::move(mapping);
+
+        return frozen;
+    }
+
+    size_t count(const key_type& key) const
+    {
+        return (find_valued(key) == npos) ? 0 : 1;
+    }
+
+    const_iterator find(const key_type& key) const
+    {
+        return const_iterator(this, find_valued(key));
+    }
+
+    const mapped_type& at(const key_type& key) const
+    {
+        node_id target = find_valued(key);
+
+        if(target != npos)
+            return value_of(target);
+        else
+            throw std::out_of_range("frozen_trie::at() was invoked with key that is not stored.");
+    }
+
+    const std::optional<std::reference_wrapper<const mapped_type>> operator[](const key_type& key) const
+    {
+        node_id target = find_valued(key);
+
+        return (target != npos) ? std::optional(std::cref(value_of(target))) : std::nullopt;
+    }
+
+    /***************************************
+     * Range of every element whose key
+     * starts with prefix, in key order.
+    ****************************************/
+    std::pair<const_iterator,const_iterator> prefix_range(const key_type& prefix) const
+    {
+        node_id subtree = find_node(prefix);
+
+        if(subtree == npos || empty())
+            return std::make_pair(cend(), cend());
+
+        return std::make_pair(const_iterator(this, first_valued(subtree)),
+                              const_iterator(this, skip_subtree(subtree)));
+    }
+
+    /***************************************
+     * Calls function with the value of every
+     * element whose key starts with prefix,
+     * in key order. Keys are never built.
+    ****************************************/
+    template<typename Function>
+    void for_each_prefix(const key_type& prefix, Function&& function) const
+    {
+        node_id subtree = find_node(prefix);
+
+        if(subtree == npos || empty())
+            return;
+
+        for(node_id current_node = first_valued(subtree), last = skip_subtree(subtree);
+            current_node != last; current_node = next_node(current_node))
+            function(value_of(current_node));
+    }
+
+private:
+
+    size_t _size;
+    key_concat  _key_concat;
+    key_compare _key_compare;
+
+    bit_vector                _louds;
+    bit_vector                _has_value;
+    frozen_array<_Key_Piece>  _labels;
+    frozen_array<mapped_type> _values;
+
+    std::shared_ptr<const void> _mapping;   // Keeps the file mapped while arrays view it
+};
+
+#endif /* FROZEN_TRIE__H */
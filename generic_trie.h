@@ -9,6 +9,19 @@
 #include <stdexcept>
 #include <stack>
 #include <iterator>
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+#include <numeric>
+#include <thread>
+#include <mutex>
+
+#include "trie_simd.h"
+#include "trie_parallel.h"
+#include "trie_counters.h"
+#include "trie_iterator.h"
 
 template<typename _Key_Piece,
          typename _Tp,
@@ -18,14 +31,22 @@ template<typename _Key_Piece,
                    typename,
                    typename> class _Key     = std::basic_string,
          template <typename> class _Traits  = std::char_traits,
-         template <typename> class _Alloc   = std::allocator>
+         template <typename> class _Alloc   = std::allocator,
+         typename _Counters                 = no_trie_counters>
 
 class trie
 {
 
 protected:
-    class  trie_node;
-    struct node_compare;
+    class trie_node;
+
+    // Frozen tries are built straight from our nodes
+    template<typename, typename, typename,
+             template <typename> class,
+             template <typename, typename, typename> class,
+             template <typename> class,
+             template <typename> class>
+    friend class frozen_trie;
 
 public:
     class iterator;
@@ -39,64 +60,78 @@ public:
     using mapped_type = _Tp;
     using value_type  = std::pair<const key_type, mapped_type&>;
     using node_type   = trie_node;
+    using allocator_type = _Alloc<_Key_Piece>;
+    using counters_type  = _Counters;
     /*********************************************************************************/
 
 protected:
     /******************************** Member classes ********************************/
-    struct trie_node
+    // Byte sized key pieces also keep their children's pieces in a packed array searched with SIMD
+    static constexpr bool simd_child_keys = is_simd_key_piece<_Key_Piece, key_compare>::value;
+    using child_keys_base = child_key_array<_Key_Piece, _Alloc<_Key_Piece>, simd_child_keys>;
+
+    struct trie_node : child_keys_base
     {
-        using key_piece_t  = _Key_Piece;
+        using key_piece_t        = _Key_Piece;
+        using children_allocator = _Alloc<trie_node>;
+        using children_type      = std::vector<trie_node, children_allocator>;
 
         key_piece_t key_piece;
-        std::reference_wrapper<const key_compare> compare;  // Needed for defining operator ==
-                                                            // because we use std::find for trie_node-s
-
         std::optional<mapped_type> value;
-        
+        size_t subtree_size;  // Elements stored in this subtree, the value of this node included
+
         trie_node* parent;
-        std::vector<trie_node> children;
+        children_type children;
 
     /*********************************** Constructors ****************************************************/
 
-        explicit trie_node(const key_compare& key_compare, 
-                           node_type* parent = nullptr) 
-            : key_piece{}, compare(key_compare), parent(parent)
+        // Nodes are compared with the trie's key_compare, they don't keep one of their own
+        explicit trie_node(node_type* parent = nullptr) 
+            : child_keys_base(inherited_allocator(parent)),
+              key_piece{}, subtree_size(0), parent(parent), children(inherited_allocator(parent))
+        {}
+
+        explicit trie_node(const children_allocator& allocator)
+            : child_keys_base(allocator), key_piece{}, subtree_size(0), parent(nullptr), children(allocator)
         {}
 
         explicit trie_node(const key_piece_t& key_piece, 
-                           const key_compare& key_compare, 
                            node_type* parent = nullptr)
-            : key_piece(key_piece), compare(key_compare), parent(parent)
+            : child_keys_base(inherited_allocator(parent)),
+              key_piece(key_piece), subtree_size(0), parent(parent), children(inherited_allocator(parent))
         {}
 
         explicit trie_node(key_piece_t&& key_piece, 
-                           const key_compare& key_compare, 
                            node_type* parent = nullptr)
-            : key_piece(std::move(key_piece)), compare(key_compare), parent(parent)
+            : child_keys_base(inherited_allocator(parent)),
+              key_piece(std::move(key_piece)), subtree_size(0), parent(parent),
+              children(inherited_allocator(parent))
         {}
 
         explicit trie_node(const key_piece_t& key_piece, 
-                           const key_compare& key_compare, 
                            const mapped_type& value, 
                            node_type* parent = nullptr)
 
-            : key_piece(key_piece), compare(key_compare), value(value), parent(parent)
+            : child_keys_base(inherited_allocator(parent)),
+              key_piece(key_piece), value(value), subtree_size(1), parent(parent),
+              children(inherited_allocator(parent))
         {}
 
         explicit trie_node(key_piece_t&& key_piece, 
-                           const key_compare& key_compare,
                            mapped_type&& value, 
                            node_type* parent = nullptr)
 
-            : key_piece(std::move(key_piece)), compare(key_compare), 
-              value(std::move(value)), parent(parent)
+            : child_keys_base(inherited_allocator(parent)),
+              key_piece(std::move(key_piece)),
+              value(std::move(value)), subtree_size(1), parent(parent), children(inherited_allocator(parent))
         {}
 
-        virtual ~trie_node() = default;
+        // Not virtual, nodes are never deleted through a base
+        ~trie_node() = default;
 
         trie_node(const trie_node& other)
-            : key_piece(other.key_piece), compare(other.compare),
-              value(other.value), parent(other.parent) ,children(other.children)
+            : child_keys_base(other), key_piece(other.key_piece),
+              value(other.value), subtree_size(other.subtree_size), parent(other.parent) ,children(other.children)
         {
             // Revalidate parent pointers since copy invalidated it
             for(auto& child : children)
@@ -104,8 +139,9 @@ protected:
         }
 
         trie_node(trie_node&& other) noexcept
-            : key_piece(std::move(other.key_piece)), compare(std::move(other.compare)),
-              value(std::move(other.value)), parent(std::move(other.parent)), 
+            : child_keys_base(std::move(other)),
+              key_piece(std::move(other.key_piece)),
+              value(std::move(other.value)), subtree_size(other.subtree_size), parent(std::move(other.parent)), 
               children(std::move(other.children))
         {
             // Revalidate parent pointers since move invalidated it
@@ -116,9 +152,10 @@ protected:
         /************************************ Assignment ****************************************/
         trie_node& operator=(const trie_node& other)
         {
+            child_keys_base::operator=(other);
             this->key_piece    = other.key_piece;
-            this->compare      = other.compare;
             this->value        = other.value;
+            this->subtree_size = other.subtree_size;
             this->children     = other.children;
             this->parent       = other.parent;
 
@@ -131,9 +168,10 @@ protected:
 
         trie_node& operator=(trie_node&& other) noexcept
         {
+            child_keys_base::operator=(std::move(other));
             this->key_piece    = std::move(other.key_piece);
-            this->compare      = std::move(other.compare);
             this->value        = std::move(other.value);
+            this->subtree_size = other.subtree_size;
             this->children     = std::move(other.children);
             this->parent       = std::move(other.parent);
 
@@ -145,54 +183,164 @@ protected:
         }
 
         /****************************************** Functionality *********************************/
-        bool operator==(const node_type& other) const
+
+        // Children are allocated the same way as their parent's siblings
+        static children_allocator inherited_allocator(const node_type* parent)
         {
-            return !compare(key_piece,other.key_piece) && !compare(other.key_piece,key_piece);
+            return (parent != nullptr) ? parent->children.get_allocator() : children_allocator{};
         }
 
-        const node_type* next_node() const
+        // Children are only ever added and removed through these two, which keep the
+        // packed child keys in step with the children vector
+        template<typename... Args>
+        typename children_type::iterator emplace_child(typename children_type::const_iterator position, Args&&... args)
         {
-            const node_type* current_node = this;
+            size_t index = position - children.cbegin();
 
-            // True -> We can't go deeper the tree
-            if(current_node->children.empty() && current_node->parent != nullptr)
-            {
-                // Going up while we are the last child
-                while(current_node == &current_node->parent->children.back())
-                {
-                    current_node = current_node->parent;
+            this->reserve_child(children.size());
+            auto child = children.emplace(position, std::forward<Args>(args)...);
+            this->insert_child(index, children.size() - 1, child->key_piece);
 
-                    // There's nowhere to move if node has no parent nor sibling
-                    if(current_node->parent == nullptr)
-                        return nullptr;
-                }
+            return child;
+        }
+
+        // One allocation for count children added afterwards
+        void reserve_children(size_t count)
+        {
+            children.reserve(count);
+            this->reserve_keys(count);
+        }
 
-                auto next_sibling = ++std::find(current_node->parent->children.begin(), 
-                                                current_node->parent->children.end(), 
-                                                *current_node);
+        /****************************************************
+         * Trims the children vector and the packed keys to
+         * what the children need. The children move, their
+         * own children are pointed at the new addresses.
+         ****************************************************/
+        void shrink_children()
+        {
+            children.shrink_to_fit();
+            this->shrink_keys();
+        }
 
-                current_node = std::addressof(*next_sibling);
-            }
-            // There is no next node if root (node with no parent) has no children
-            else if(current_node->children.empty() && current_node->parent == nullptr)
-                return nullptr;
-            // If node has child we select that branch
-            else
-                current_node = &this->children.front();
+        void erase_child(typename children_type::const_iterator position)
+        {
+            size_t index = position - children.cbegin();
+
+            children.erase(position);
+            child_keys_base::erase_child(index, children.size() + 1);
+        }
+
+        /****************************************************
+         * First node holding a value in this subtree, which
+         * has to contain one. Every step down is reported to
+         * descend(child).
+         ****************************************************/
+        template<typename Descend>
+        const node_type* first_valued(Descend&& descend) const
+        {
+            const node_type* current_node = this;
 
             // Expanding first child until we have one with value
             while(!current_node->value.has_value())
+            {
                 current_node = &current_node->children.front();
+                descend(*current_node);
+            }
 
             return current_node;
         }
 
+        const node_type* first_valued() const
+        {
+            return first_valued([](const node_type&){});
+        }
+
+        node_type* first_valued()
+        {
+            return const_cast<node_type*>(static_cast<const trie_node*>(this)->first_valued());
+        }
+
+        /****************************************************
+         * First node holding a value after this subtree, in
+         * key order. Steps are reported like in next_node.
+         ****************************************************/
+        template<typename Ascend, typename Descend>
+        const node_type* skip_subtree(Ascend&& ascend, Descend&& descend) const
+        {
+            const node_type* current_node = this;
+
+            // Root's subtree is the whole trie
+            if(current_node->parent == nullptr)
+                return nullptr;
+
+            // Going up while we are the last child
+            while(current_node == &current_node->parent->children.back())
+            {
+                current_node = current_node->parent;
+                ascend();
+
+                // There's nowhere to move if node has no parent nor sibling
+                if(current_node->parent == nullptr)
+                    return nullptr;
+            }
+
+            // Siblings are stored next to each other in the parent's children
+            current_node = current_node + 1;
+            ascend();
+            descend(*current_node);
+
+            return current_node->first_valued(descend);
+        }
+
+        const node_type* skip_subtree() const
+        {
+            return skip_subtree([]{}, [](const node_type&){});
+        }
+
+        node_type* skip_subtree()
+        {
+            return const_cast<node_type*>(static_cast<const trie_node*>(this)->skip_subtree());
+        }
+
+        /****************************************************
+         * Next node holding a value in key order. Every step
+         * taken is reported: ascend() when moving up to the
+         * parent, descend(child) when moving down into child.
+         * Moving to a sibling is an ascend and a descend.
+         ****************************************************/
+        template<typename Ascend, typename Descend>
+        const node_type* next_node(Ascend&& ascend, Descend&& descend) const
+        {
+            // We can't go deeper the tree
+            if(children.empty())
+                return skip_subtree(ascend, descend);
+
+            // If node has child we select that branch
+            const node_type* current_node = &children.front();
+            descend(*current_node);
+
+            return current_node->first_valued(descend);
+        }
+
+        template<typename Ascend, typename Descend>
+        node_type* next_node(Ascend&& ascend, Descend&& descend)
+        {
+            return const_cast<node_type*>(static_cast<const trie_node*>(this)->next_node(ascend, descend));
+        }
+
+        const node_type* next_node() const
+        {
+            return next_node([]{}, [](const node_type&){});
+        }
+
         node_type* next_node()
         {
             return const_cast<node_type*>(static_cast<const trie_node*>(this)->next_node());
         }
 
-        const node_type* previous_node() const
+        // Previous node holding a value, steps are reported like in next_node
+        template<typename Ascend, typename Descend>
+        const node_type* previous_node(Ascend&& ascend, Descend&& descend) const
         {
             const node_type* current_node = this;
 
@@ -204,6 +352,7 @@ protected:
             while(current_node == &current_node->parent->children.front())
             {
                 current_node = current_node->parent;
+                ascend();
 
                 if(current_node->value.has_value())
                     return current_node;
@@ -212,20 +361,31 @@ protected:
                     return nullptr;
             }
 
-            // Find left sibling
-            auto prev_sibling = --std::find(current_node->parent->children.begin(),
-                                            current_node->parent->children.end(),
-                                           *current_node);
-
+            // Left sibling is stored right before us, find its rightmost node
+            current_node = current_node - 1;
+            ascend();
+            descend(*current_node);
 
-            // Find rightmost node of left sibling
-            current_node = std::addressof(*prev_sibling);
             while(!current_node->children.empty())
+            {
                 current_node = &current_node->children.back();
+                descend(*current_node);
+            }
 
             return current_node;
         }
 
+        template<typename Ascend, typename Descend>
+        node_type* previous_node(Ascend&& ascend, Descend&& descend)
+        {
+            return const_cast<node_type*>(static_cast<const trie_node*>(this)->previous_node(ascend, descend));
+        }
+
+        const node_type* previous_node() const
+        {
+            return previous_node([]{}, [](const node_type&){});
+        }
+
         node_type* previous_node()
         {
             return const_cast<node_type*>(static_cast<const trie_node*>(this)->previous_node());
@@ -248,27 +408,75 @@ protected:
                 concat(key,reversed_key.top());
                 reversed_key.pop();
             }
+
+            _Counters::trace_key(key.size() * sizeof(typename key_type::value_type));
             return key;
         }
     };
 
     /********************************************************
-     * @brief Compares nodes with provided template argument
-     * key_compare in order to maintain class invariance in
-     * children vectors.
+     * @brief Key of the node an iterator points to. It is
+     * traced once and then kept up to date piece by piece
+     * while the iterator moves, so stepping and reading keys
+     * through key() and value() does not allocate after
+     * warm-up. Elements read through * and -> still copy
+     * the key.
+     * Copies start untraced and trace again when their key
+     * is read, so copying an iterator, as postfix ++ and
+     * reverse_iterator do, does not allocate.
      ********************************************************/
-    struct node_compare
+    class key_buffer
     {
-        explicit node_compare(const key_compare& compare)
-            : compare(compare){}
+    public:
+        key_buffer() = default;
+        key_buffer(const key_buffer&) noexcept {}
+        key_buffer(key_buffer&&) noexcept = default;
+
+        // Keeps the capacity already allocated here for the next trace
+        key_buffer& operator=(const key_buffer&) noexcept { reset(); return *this; }
+        key_buffer& operator=(key_buffer&&) noexcept = default;
+
+        bool traced() const noexcept { return _traced; }
+        const key_type& key() const noexcept { return _key; }
+
+        void trace(const node_type* node, const key_concat& concat)
+        {
+            std::vector<const node_type*> reversed_path;
+            for(; node->parent != nullptr; node = node->parent)
+                reversed_path.push_back(node);
+
+            reset();
+            for(auto it = reversed_path.rbegin(); it != reversed_path.rend(); ++it)
+                push((*it)->key_piece, concat);
+
+            _Counters::trace_key(_key.size() * sizeof(typename key_type::value_type));
+            _traced = true;
+        }
+
+        void reset() noexcept
+        {
+            _key.clear();
+            _piece_offsets.clear();
+            _traced = false;
+        }
+
+        void push(const _Key_Piece& key_piece, const key_concat& concat)
+        {
+            _piece_offsets.push_back(_key.size());
+            concat(_key, key_piece);
+        }
 
-        bool operator()(const node_type& lhs, const node_type& rhs) const
+        void pop()
         {
-            return compare(lhs.key_piece,rhs.key_piece);
+            _key.resize(_piece_offsets.back());
+            _piece_offsets.pop_back();
         }
 
-        const key_compare& compare;
-    };    
+    private:
+        key_type _key;
+        std::vector<typename key_type::size_type> _piece_offsets;  // Concat may append more than one element
+        bool _traced = false;
+    };
 
 public:
     /***************************************** Iterator *******************************************/
@@ -281,7 +489,7 @@ public:
         using iterator_category = std::bidirectional_iterator_tag;
         using difference_type   = std::ptrdiff_t;
         using value_type        = trie::value_type;
-        using pointer           = std::unique_ptr<value_type>;
+        using pointer           = arrow_proxy<value_type>;
         using reference         = value_type;
         
         explicit iterator(node_type* ptr, const key_concat& concat) 
@@ -295,19 +503,39 @@ public:
         iterator& operator=(const iterator&)     = default;
         iterator& operator=(iterator&&) noexcept = default;
 
+        // Elements own a copy of the key, so they outlive the iterator and reverse_iterator's temporaries
         reference operator* () const 
         { 
-            return value_type(_pointed_node->trace_key(_concat), _pointed_node->value.value()); 
+            return value_type(key(), _pointed_node->value.value()); 
         }
 
         pointer operator->() const 
         { 
-            return std::make_unique<value_type>(_pointed_node->trace_key(_concat),_pointed_node->value.value()); 
+            return pointer{value_type(key(), _pointed_node->value.value())}; 
+        }
+
+        // Key of the pointed element without copying it, valid until the iterator moves or dies
+        const trie::key_type& key() const
+        {
+            if(!_key.traced())
+                _key.trace(_pointed_node, _concat);
+
+            return _key.key();
         }
+
+        mapped_type& value() const { return _pointed_node->value.value(); }
         
         iterator& operator++()
         {
-            _pointed_node = _pointed_node->next_node();
+            if(_key.traced())
+                _pointed_node = _pointed_node->next_node([&]{ _key.pop(); },
+                                                         [&](const node_type& node){ _key.push(node.key_piece, _concat); });
+            else
+                _pointed_node = _pointed_node->next_node();
+
+            if(_pointed_node == nullptr)
+                _key.reset();
+
             return *this;
         }
 
@@ -320,7 +548,15 @@ public:
 
         iterator& operator--()
         {
-            _pointed_node = _pointed_node->previous_node();
+            if(_key.traced())
+                _pointed_node = _pointed_node->previous_node([&]{ _key.pop(); },
+                                                             [&](const node_type& node){ _key.push(node.key_piece, _concat); });
+            else
+                _pointed_node = _pointed_node->previous_node();
+
+            if(_pointed_node == nullptr)
+                _key.reset();
+
             return *this;
         }
 
@@ -337,6 +573,7 @@ public:
     private:
         node_type* _pointed_node;
         const key_concat& _concat;
+        mutable key_buffer _key;
     };
 
     class const_iterator
@@ -347,7 +584,7 @@ public:
         using iterator_category = std::bidirectional_iterator_tag;
         using difference_type   = std::ptrdiff_t;
         using value_type        = std::pair<const trie::key_type, const mapped_type&>;
-        using pointer           = std::unique_ptr<value_type>;
+        using pointer           = arrow_proxy<value_type>;
         using reference         = value_type;
 
         explicit const_iterator(const node_type* ptr, const key_concat& concat) 
@@ -356,7 +593,7 @@ public:
         // We are allowing implicit conversion from iterator -> const interator
         const_iterator(const iterator& it)
             : _pointed_node(it._pointed_node), 
-              _concat(it._concat) {}
+              _concat(it._concat), _key(it._key) {}
 
 
         virtual ~const_iterator()                        = default;
@@ -366,19 +603,39 @@ public:
         const_iterator& operator=(const const_iterator&)     = default;
         const_iterator& operator=(const_iterator&&) noexcept = default;
 
+        // Elements own a copy of the key, so they outlive the iterator and reverse_iterator's temporaries
         reference operator* () const 
         { 
-            return value_type(_pointed_node->trace_key(_concat), _pointed_node->value.value()); 
+            return value_type(key(), _pointed_node->value.value()); 
         }
 
         pointer operator->() const 
         { 
-            return std::make_unique<value_type>(_pointed_node->trace_key(_concat),_pointed_node->value.value()); 
+            return pointer{value_type(key(), _pointed_node->value.value())}; 
+        }
+
+        // Key of the pointed element without copying it, valid until the iterator moves or dies
+        const trie::key_type& key() const
+        {
+            if(!_key.traced())
+                _key.trace(_pointed_node, _concat);
+
+            return _key.key();
         }
+
+        const mapped_type& value() const { return _pointed_node->value.value(); }
         
         const_iterator& operator++()
         {
-            _pointed_node = _pointed_node->next_node();
+            if(_key.traced())
+                _pointed_node = _pointed_node->next_node([&]{ _key.pop(); },
+                                                         [&](const node_type& node){ _key.push(node.key_piece, _concat); });
+            else
+                _pointed_node = _pointed_node->next_node();
+
+            if(_pointed_node == nullptr)
+                _key.reset();
+
             return *this;
         }
 
@@ -391,7 +648,15 @@ public:
 
         const_iterator& operator--()
         {
-            _pointed_node = _pointed_node->previous_node();
+            if(_key.traced())
+                _pointed_node = _pointed_node->previous_node([&]{ _key.pop(); },
+                                                             [&](const node_type& node){ _key.push(node.key_piece, _concat); });
+            else
+                _pointed_node = _pointed_node->previous_node();
+
+            if(_pointed_node == nullptr)
+                _key.reset();
+
             return *this;
         }
 
@@ -408,27 +673,18 @@ public:
     private:
         const node_type* _pointed_node;
         const key_concat& _concat;
+        mutable key_buffer _key;
     };
 
     // ITERATORS
     iterator begin() noexcept
     {
-        node_type* current_node = &_root;
-
-        while(!current_node->value.has_value())
-            current_node = &current_node->children.front();
-
-        return (current_node->value.has_value()) ? iterator(current_node, _key_concat) : end();
+        return empty() ? end() : iterator(_root.first_valued(), _key_concat);
     }
 
     const_iterator begin()  const noexcept 
     {
-        const node_type* current_node = &_root;
-
-        while(!current_node->value.has_value())
-            current_node = &current_node->children.front();
-
-        return (current_node->value.has_value()) ? const_iterator(current_node, _key_concat) : end();
+        return empty() ? end() : const_iterator(_root.first_valued(), _key_concat);
     }
 
     iterator       end()          noexcept { return iterator(nullptr, _key_concat);       }
@@ -464,156 +720,1402 @@ public:
     std::reverse_iterator<const_iterator> crbegin() const noexcept { return rbegin(); }
     std::reverse_iterator<const_iterator> crend() const noexcept { return rend(); }
 
+protected:
+    /********************************************************
+     * @brief Keys the lookups take besides key_type: any
+     * range of key pieces, such as a string_view or a span,
+     * and C strings, which are cut at their terminator the
+     * way key_type would cut them.
+     ********************************************************/
+    template<typename Key, typename = void>
+    struct is_key_range
+        : std::integral_constant<bool, std::is_pointer<Key>::value &&
+                                       std::is_same<std::remove_cv_t<std::remove_pointer_t<Key>>, _Key_Piece>::value>
+    {};
+
+    // Pieces must be _Key_Piece exactly, a wider type would be cut down at every comparison
+    template<typename Key>
+    struct is_key_range<Key, std::void_t<decltype(std::begin(std::declval<const Key&>())),
+                                         decltype(std::end(std::declval<const Key&>()))>>
+        : std::is_same<std::remove_cv_t<std::remove_reference_t<decltype(*std::begin(std::declval<const Key&>()))>>, _Key_Piece>
+    {};
+
+    template<typename Key>
+    using if_key_range = std::enable_if_t<is_key_range<Key>::value, int>;
+
+    struct piece_span
+    {
+        const _Key_Piece* first;
+        const _Key_Piece* last;
+
+        const _Key_Piece* begin() const noexcept { return first; }
+        const _Key_Piece* end()   const noexcept { return last;  }
+    };
+
+    template<typename Key>
+    static decltype(auto) key_pieces(const Key& key)
+    {
+        if constexpr(std::is_array<Key>::value && std::is_same<std::remove_cv_t<std::remove_extent_t<Key>>, _Key_Piece>::value)
+            return piece_span{std::begin(key), std::find(std::begin(key), std::end(key), _Key_Piece{})};
+        else if constexpr(std::is_pointer<Key>::value)
+            return piece_span{key, key + _Traits<_Key_Piece>::length(key)};
+        else
+            return (key);
+    }
+
 private:
     /*************************************** Private Functionality ******************************************/
 
-    const node_type* find_node(const key_type& key) const
+    /********************************************************
+     * @brief Allocators can hand every trie its own state by
+     * providing select_on_trie_construction(), the way
+     * arena_allocator binds to a new arena. Any other
+     * allocator is used as it is.
+     ********************************************************/
+    template<typename Allocator>
+    static auto select_node_allocator(const Allocator& allocator, int)
+        -> decltype(allocator.select_on_trie_construction())
     {
-        const node_type* current_node = &_root;
-        for(const auto& key_piece : key)
-        {
-            auto branch = std::find_if(current_node->children.begin(), current_node->children.end(), 
-                                       [&](const node_type& child) { return child.key_piece == key_piece; });
+        return allocator.select_on_trie_construction();
+    }
 
-            if(branch == current_node->children.end())
-                return nullptr;
-            else
-                current_node = std::addressof(*branch);
-        }
-        return current_node;
+    template<typename Allocator>
+    static Allocator select_node_allocator(const Allocator& allocator, long)
+    {
+        return allocator;
     }
 
-    node_type* find_node(const key_type& key)
+    /********************************************************
+     * @brief Binary searches the first child whose key piece
+     * is not less than key_piece. Relies on children being
+     * kept sorted by key piece with _key_compare.
+     ********************************************************/
+    template<typename Node>
+    auto lower_bound_child(Node& node, const _Key_Piece& key_piece) const
     {
-        return const_cast<node_type*>(static_cast<const trie*>(this)->find_node(key));
+        _Counters::visit_node();
+        return std::lower_bound(node.children.begin(), node.children.end(), key_piece,
+                                [&](const node_type& child, const _Key_Piece& piece) { return piece_less(child.key_piece, piece); });
     }
 
-    bool erase_node(node_type* node)
+    // key_compare as the child searches use it, reported to _Counters
+    bool piece_less(const _Key_Piece& lhs, const _Key_Piece& rhs) const
     {
-        if(node == nullptr || !node->value.has_value())
-            return false;
+        _Counters::compare_child();
+        return _key_compare(lhs, rhs);
+    }
 
-        node->value.reset();
-        --_size;
-        
-        node_type* current_node = node;
-        node_type* parent = node->parent;
-        
-        while(current_node->children.empty() && !current_node->value.has_value() && current_node->parent != nullptr)
+    const node_type* find_child(const node_type& node, const _Key_Piece& key_piece) const
+    {
+        if constexpr(simd_child_keys)
         {
-            parent->children.erase(std::find(parent->children.begin(),parent->children.end(),*current_node));
-            current_node = parent;
-            parent = current_node->parent;
+            _Counters::visit_node();
+            size_t index = node.find_child(key_piece, node.children.size());
+            return (index < node.children.size()) ? &node.children[index] : nullptr;
         }
 
-        return true;
+        auto branch = lower_bound_child(node, key_piece);
+
+        return (branch != node.children.end() && !piece_less(key_piece, branch->key_piece))
+                    ? std::addressof(*branch) : nullptr;
     }
 
-public:
-    /********************************* Constructors **********************************/
-    explicit trie(const key_concat&  concat,
-                  const key_compare& compare = key_compare{})
+    template<typename Key>
+    const node_type* find_node(const Key& key) const
+    {
+        const node_type* current_node = &_root;
+        for(const auto& key_piece : key_pieces(key))
+        {
+            current_node = find_child(*current_node, key_piece);
 
-        : _size{0}, _key_concat{concat}, _key_compare{compare},
-          _node_compare{compare}, _root{_key_compare}
-    {}
+            if(current_node == nullptr)
+                return nullptr;
+        }
+        return current_node;
+    }
 
-    trie(const trie&)     = default;
-    trie(trie&&) noexcept = default;
-    virtual ~trie()       = default;
+    template<typename Key>
+    node_type* find_node(const Key& key)
+    {
+        return const_cast<node_type*>(static_cast<const trie*>(this)->find_node(key));
+    }
 
-    /****************************** Assignment operators *****************************/
+    static void prefetch(const void* address) noexcept
+    {
+#if defined(__GNUC__)
+        __builtin_prefetch(address);
+#else
+        (void)address;
+#endif
+    }
 
-    trie& operator=(const trie& other) = default;
-    trie& operator=(trie&&) noexcept   = default;
+    // Runs find_node's descent for up to batch_width keys at a time, one level per round,
+    // so that the child arrays fetched for one key are loaded while the others are searched
+    static constexpr size_t batch_width = 16;
 
-    /*********************************************************************************/
+    template<typename ForwardIt, typename Found>
+    void find_nodes(ForwardIt first, ForwardIt last, Found found) const
+    {
+        // Lanes walk the keys after first has moved past them, so the keys have to stay where they are
+        static_assert(std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<ForwardIt>::iterator_category>::value,
+                      "find_batch takes forward iterators");
+        static_assert(std::is_lvalue_reference<typename std::iterator_traits<ForwardIt>::reference>::value,
+                      "find_batch takes iterators to stored keys, not to keys made on the fly");
 
-    /****************************** Public Functionality *****************************/
-    bool   empty() const noexcept { return _size == 0;  }
-    size_t size()  const noexcept { return _size;       } 
+        // Keys are walked in place, whatever key range or C string the input holds
+        using piece_iterator = decltype(std::begin(key_pieces(*first)));
 
-    size_t count(const key_type& key) const
-    {
-        return (find(key) == cend()) ? 0 : 1;
-    }
+        struct lane
+        {
+            const node_type* node;
+            piece_iterator   piece;
+            piece_iterator   end;
+        };
 
-    /***************************************
-     * Invalidates all previous iterators !!
-    ****************************************/
-    template<typename Key, typename Value>
-    std::pair<iterator,bool> emplace(Key&& key, Value&& value)
-    {
-        node_type* current_node = &_root;
+        std::array<lane, batch_width> lanes;
 
-        for(auto& key_piece : key_type(std::forward<Key>(key)))
+        while(first != last)
         {
-            // Lookup branch
-            auto branch = std::find_if(current_node->children.begin(), current_node->children.end(), 
-                                       [&](const node_type& child) { return !_key_compare(child.key_piece,key_piece) &&
-                                                                            !_key_compare(key_piece,child.key_piece);});
+            size_t width = 0;
+            for(; width < batch_width && first != last; ++width, ++first)
+            {
+                auto&& pieces = key_pieces(*first);
+                lanes[width] = lane{&_root, std::begin(pieces), std::end(pieces)};
+            }
 
-            // We need new branch if it doesn't exist
-            if(branch == current_node->children.end())
+            for(bool descending = true; descending;)
             {
-                current_node->children.emplace_back(key_piece, _key_compare ,current_node);
+                descending = false;
+                for(size_t i = 0; i < width; ++i)
+                {
+                    lane& current = lanes[i];
+                    if(current.node == nullptr || current.piece == current.end)
+                        continue;
 
-                // Sort children to regain search tree invariant
-                std::sort(current_node->children.begin(),
-                          current_node->children.end(),
-                          _node_compare);
+                    current.node = find_child(*current.node, *current.piece);
+                    ++current.piece;
 
-                // Locate next node since sorting might moved it
-                auto next_node = std::find_if(current_node->children.begin(), current_node->children.end(), 
-                                       [&](const node_type& child) { return !_key_compare(child.key_piece,key_piece) &&
-                                                                            !_key_compare(key_piece,child.key_piece);});
+                    if(current.node != nullptr && current.piece != current.end)
+                    {
+                        if constexpr(simd_child_keys)
+                            prefetch(current.node->child_keys());
 
-                current_node = std::addressof(*next_node);
+                        prefetch(current.node->children.data());
+                        descending = true;
+                    }
+                }
+            }
+
+            for(size_t i = 0; i < width; ++i)
+            {
+                const node_type* target = lanes[i].node;
+                found((target != nullptr && target->value.has_value()) ? target : nullptr);
             }
-            else
-                current_node = std::addressof(*branch);
         }
+    }
 
-        bool emplaced = false;
-        if(!current_node->value.has_value())
+    // Deepest node holding a value on the path of key, found in the same descent as find_node
+    template<typename Key>
+    const node_type* find_longest_prefix(const Key& key) const
+    {
+        const node_type* current_node = &_root;
+        const node_type* longest      = _root.value.has_value() ? &_root : nullptr;
+
+        for(const auto& key_piece : key_pieces(key))
         {
-            current_node->value.emplace(std::forward<Value>(value));
-            emplaced = true;
-            ++_size;
-        }
+            current_node = find_child(*current_node, key_piece);
 
-        return std::make_pair(iterator(current_node, _key_concat),emplaced);
+            if(current_node == nullptr)
+                break;
+
+            if(current_node->value.has_value())
+                longest = current_node;
+        }
+        return longest;
     }
 
-    /***************************************
-     * Invalidates all iterators !!
-    ****************************************/
-    size_t erase(const key_type& key)
+    template<typename Key>
+    node_type* find_longest_prefix(const Key& key)
     {
-        return (erase_node(find_node(key))) ? 1 : 0;
+        return const_cast<node_type*>(static_cast<const trie*>(this)->find_longest_prefix(key));
     }
 
-    /***************************************
-     * Invalidates all iterators !!
-    ****************************************/
-    void erase(iterator pos)
+    // Descends into the child holding the k-th element of the subtree at each level
+    const node_type* select_node(size_t k) const
     {
-        erase_node(pos._pointed_node);
+        if(k >= _size)
+            return nullptr;
+
+        const node_type* current_node = &_root;
+        while(true)
+        {
+            if(current_node->value.has_value())
+            {
+                if(k == 0)
+                    return current_node;
+                --k;
+            }
+
+            auto child = current_node->children.begin();
+            for(; k >= child->subtree_size; ++child)
+                k -= child->subtree_size;
+
+            current_node = std::addressof(*child);
+        }
     }
 
-    iterator find(const key_type& key)
+    /********************************************************
+     * @brief Share of a parallel traversal run by one task:
+     * the whole subtree of node, or only the value of node
+     * when its children were made tasks of their own.
+     ********************************************************/
+    struct traversal_task
+    {
+        const node_type* node;
+        bool             subtree;
+    };
+
+    // Tasks a parallel traversal aims for per thread, so that stealing can even out their sizes
+    static constexpr size_t tasks_per_thread = 8;
+
+    static size_t task_size(const traversal_task& task) noexcept
     {
-        node_type* target = find_node(key);
-        return (target != nullptr && target->value.has_value()) ? iterator(target, _key_concat) : end();
+        return task.subtree ? task.node->subtree_size : 1;
     }
 
-    const_iterator find(const key_type& key) const
+    // Splits a non-empty trie into at least task_count tasks if it can, listed in key order
+    std::vector<traversal_task> split_traversal(size_t task_count) const
     {
-        const node_type* target = find_node(key);
-        return (target != nullptr && target->value.has_value()) ? const_iterator(target, _key_concat) : cend();
+        std::vector<traversal_task> tasks{{&_root, true}};
+
+        while(tasks.size() < task_count)
+        {
+            // Splitting the biggest subtree that still has children first
+            auto splittable_size = [](const traversal_task& task)
+            {
+                return (task.subtree && !task.node->children.empty()) ? task.node->subtree_size : 0;
+            };
+            auto biggest = std::max_element(tasks.begin(), tasks.end(), [&](const traversal_task& lhs, const traversal_task& rhs)
+            {
+                return splittable_size(lhs) < splittable_size(rhs);
+            });
+
+            if(splittable_size(*biggest) == 0)
+                break;
+
+            const node_type* node = biggest->node;
+            std::vector<traversal_task> split;
+            if(node->value.has_value())
+                split.push_back({node, false});
+            for(const auto& child : node->children)
+                split.push_back({&child, true});
+
+            biggest = tasks.erase(biggest);
+            tasks.insert(biggest, split.begin(), split.end());
+        }
+        return tasks;
+    }
+
+    /********************************************************
+     * @brief Runs visit(key, node) for every node holding a
+     * value in each task, on up to thread_count threads.
+     * run_task(index, walk) is called once per task in
+     * tasks, in no particular order, and walks it by
+     * calling walk(visit).
+     ********************************************************/
+    template<typename RunTask>
+    void run_traversal(const std::vector<traversal_task>& tasks, size_t thread_count, RunTask&& run_task) const
+    {
+        // Biggest subtrees are dealt out first
+        std::vector<size_t> schedule(tasks.size());
+        std::iota(schedule.begin(), schedule.end(), size_t{0});
+        std::stable_sort(schedule.begin(), schedule.end(), [&](size_t lhs, size_t rhs)
+        {
+            return task_size(tasks[lhs]) > task_size(tasks[rhs]);
+        });
+
+        work_stealing_pool(thread_count).run(schedule.size(), [&](size_t scheduled)
+        {
+            size_t index = schedule[scheduled];
+            const traversal_task& task = tasks[index];
+
+            run_task(index, [&](auto&& visit)
+            {
+                key_buffer key;
+                key.trace(task.node, _key_concat);
+
+                if(!task.subtree)
+                {
+                    visit(key.key(), *task.node);
+                    return;
+                }
+
+                auto ascend  = [&]{ key.pop(); };
+                auto descend = [&](const node_type& node){ key.push(node.key_piece, _key_concat); };
+
+                for(const node_type *current_node = task.node->first_valued(descend), *last = task.node->skip_subtree();
+                    current_node != last; current_node = current_node->next_node(ascend, descend))
+                    visit(key.key(), *current_node);
+            });
+        });
+    }
+
+    /********************************************************
+     * @brief Stream format of serialize(). After a header
+     * the nodes follow in depth first order, each as a
+     * varint holding its child count shifted left by one
+     * with the value flag in the lowest bit, then its value
+     * if any, then every child as its key piece followed by
+     * the child itself.
+     ********************************************************/
+    static constexpr char stream_magic[8] = {'T', 'R', 'I', 'E', 'S', 'T', 'R', '1'};
+
+    // Codec of serialize() and deserialize() without one, for trivially copyable values
+    struct raw_codec
+    {
+        void encode(std::ostream& out, const mapped_type& value) const
+        {
+            write_raw(out, value);
+        }
+
+        mapped_type decode(std::istream& in) const
+        {
+            mapped_type value;
+            read_raw(in, value);
+            return value;
+        }
+    };
+
+    template<typename T>
+    static void write_raw(std::ostream& out, const T& object)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable objects are written as raw bytes");
+        out.write(reinterpret_cast<const char*>(std::addressof(object)), sizeof(T));
+    }
+
+    // Goes to the stream buffer directly, istream::read would build a sentry per piece
+    template<typename T>
+    static void read_raw(std::istream& in, T& object)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable objects are read as raw bytes");
+        if(in.rdbuf()->sgetn(reinterpret_cast<char*>(std::addressof(object)), sizeof(T)) != sizeof(T))
+        {
+            in.setstate(std::ios::eofbit | std::ios::failbit);
+            throw std::runtime_error("trie::deserialize() ran out of input.");
+        }
+    }
+
+    static void write_varint(std::ostream& out, std::uint64_t number)
+    {
+        for(; number >= 0x80; number >>= 7)
+            out.put(static_cast<char>(number | 0x80));
+
+        out.put(static_cast<char>(number));
+    }
+
+    static std::uint64_t read_varint(std::istream& in)
+    {
+        std::uint64_t number = 0;
+        for(unsigned shift = 0; shift < 64; shift += 7)
+        {
+            std::uint8_t byte;
+            read_raw(in, byte);
+
+            number |= std::uint64_t{byte & 0x7fu} << shift;
+            if((byte & 0x80) == 0)
+                return number;
+        }
+        throw std::runtime_error("trie::deserialize() found a malformed child count.");
+    }
+
+    template<typename Codec>
+    static void write_node(std::ostream& out, const node_type& node, Codec& codec)
+    {
+        write_varint(out, std::uint64_t{node.children.size()} << 1 | (node.value.has_value() ? 1 : 0));
+
+        if(node.value.has_value())
+            codec.encode(out, node.value.value());
+    }
+
+    /********************************************************
+     * @brief Reads the value of node and reserves room for
+     * its children, returns how many follow. Counts beyond
+     * the distinct key pieces are rejected, the reservation
+     * is also capped by what the stream has buffered, so a
+     * corrupt count can't allocate more than the input could
+     * hold. The children vector grows past that as needed.
+     ********************************************************/
+    template<typename Codec>
+    static size_t read_node(std::istream& in, node_type& node, Codec& codec)
+    {
+        std::uint64_t header      = read_varint(in);
+        std::uint64_t child_count = header >> 1;
+
+        if constexpr(sizeof(_Key_Piece) < sizeof(std::uint64_t))
+        {
+            if(child_count > std::uint64_t{1} << (8 * sizeof(_Key_Piece)))
+                throw std::runtime_error("trie::deserialize() found more children than distinct key pieces.");
+        }
+
+        if(header & 1)
+            node.value.emplace(codec.decode(in));
+        else if(child_count == 0 && node.parent != nullptr)
+            throw std::runtime_error("trie::deserialize() found a node without value nor children.");
+
+        // Every child takes at least its key piece and a header byte
+        std::streamsize buffered = std::max<std::streamsize>(in.rdbuf()->in_avail(), 0);
+        node.reserve_children(static_cast<size_t>(std::min<std::uint64_t>(child_count, static_cast<std::uint64_t>(buffered) / (sizeof(_Key_Piece) + 1))));
+
+        return static_cast<size_t>(child_count);
+    }
+
+    /********************************************************
+     * @brief Removes the nodes left below node with neither
+     * value nor children, returns whether node itself ended
+     * up that way. Only needed after a build was cut short.
+     ********************************************************/
+    static bool prune_empty(node_type& node)
+    {
+        for(size_t index = node.children.size(); index-- > 0; )
+        {
+            if(prune_empty(node.children[index]))
+                node.erase_child(node.children.cbegin() + index);
+        }
+        return node.children.empty() && !node.value.has_value();
+    }
+
+    /********************************************************
+     * @brief Runs work with the counts it adds to _Counters
+     * moved to moved, and the thread's own counts left as
+     * they were, so that another thread can take them over.
+     ********************************************************/
+    template<typename Work>
+    static void count_apart(trie_counter_values& moved, Work&& work)
+    {
+        if constexpr(_Counters::enabled)
+        {
+            trie_counter_values before = _Counters::read();
+            _Counters::reset();
+
+            auto restore = [&]
+            {
+                moved = _Counters::read();
+                _Counters::reset();
+                _Counters::add(before);
+            };
+
+            try
+            {
+                work();
+            }
+            catch(...)
+            {
+                restore();
+                throw;
+            }
+            restore();
+        }
+        else
+            work();
+    }
+
+    // Counts a value given to node in the subtree sizes from node up to top
+    static void count_added(node_type* node, const node_type* top)
+    {
+        for(;; node = node->parent)
+        {
+            ++node->subtree_size;
+            if(node == top)
+                break;
+        }
+    }
+
+    // Body of emplace_parallel, which cleans up after it when it throws
+    template<typename ForwardIt>
+    void emplace_partitioned(ForwardIt first, ForwardIt last, size_t thread_count)
+    {
+        // Root children for every first piece are added up front, later threads only change their own
+        std::vector<ForwardIt> elements;
+        for(ForwardIt it = first; it != last; ++it)
+        {
+            auto piece = std::begin(it->first);
+
+            if(piece == std::end(it->first))
+            {
+                if(!_root.value.has_value())
+                {
+                    _root.value.emplace(it->second);
+                    ++_root.subtree_size;
+                    ++_size;
+                }
+                continue;
+            }
+
+            emplace_path(&_root, piece, std::next(piece));
+            elements.push_back(it);
+        }
+
+        // Counting sort by root child, keeping the order of the pairs under each
+        std::vector<size_t> branches(elements.size());
+        std::vector<size_t> offsets(_root.children.size() + 1, 0);
+        for(size_t i = 0; i < elements.size(); ++i)
+        {
+            branches[i] = find_child(_root, *std::begin(elements[i]->first)) - _root.children.data();
+            ++offsets[branches[i] + 1];
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        std::vector<ForwardIt> partitioned(elements.size());
+        std::vector<size_t>    next(offsets.begin(), offsets.end() - 1);
+        for(size_t i = 0; i < elements.size(); ++i)
+            partitioned[next[branches[i]]++] = elements[i];
+
+        std::vector<size_t> tasks;
+        for(size_t branch = 0; branch < _root.children.size(); ++branch)
+            if(offsets[branch] != offsets[branch + 1])
+                tasks.push_back(branch);
+
+        std::sort(tasks.begin(), tasks.end(), [&](size_t lhs, size_t rhs)
+        {
+            return offsets[lhs + 1] - offsets[lhs] > offsets[rhs + 1] - offsets[rhs];
+        });
+
+        std::vector<size_t> emplaced(_root.children.size(), 0);
+        std::vector<trie_counter_values> counted(tasks.size());
+        auto count_emplaced = [&]
+        {
+            for(size_t count : emplaced)
+            {
+                _root.subtree_size += count;
+                _size += count;
+            }
+
+            if constexpr(_Counters::enabled)
+            {
+                for(const auto& values : counted)
+                    _Counters::add(values);
+            }
+        };
+
+        try
+        {
+            work_stealing_pool(thread_count).run(tasks.size(), [&](size_t task)
+            {
+                size_t     branch  = tasks[task];
+                node_type* subtree = &_root.children[branch];
+
+                count_apart(counted[task], [&]
+                {
+                    for(size_t i = offsets[branch]; i < offsets[branch + 1]; ++i)
+                    {
+                        const auto& key     = partitioned[i]->first;
+                        node_type*  current = emplace_path(subtree, std::next(std::begin(key)), std::end(key));
+
+                        if(!current->value.has_value())
+                        {
+                            current->value.emplace(partitioned[i]->second);
+                            count_added(current, subtree);
+                            ++emplaced[branch];
+                        }
+                    }
+                });
+            });
+        }
+        catch(...)
+        {
+            count_emplaced();
+            throw;
+        }
+        count_emplaced();
+    }
+
+    // Node at the end of the pieces [first, last) below node, the missing branches are added
+    template<typename PieceIt>
+    node_type* emplace_path(node_type* node, PieceIt first, PieceIt last)
+    {
+        node_type* current_node = node;
+
+        for(; first != last; ++first)
+        {
+            // Lookup branch
+            auto branch = lower_bound_child(*current_node, *first);
+
+            // We need new branch if it doesn't exist. Inserting it at its sorted
+            // position keeps the search tree invariant and only shifts the siblings after it
+            if(branch == current_node->children.end() || piece_less(*first, branch->key_piece))
+            {
+                branch = current_node->emplace_child(branch, *first, current_node);
+                _Counters::insert_child();
+            }
+
+            current_node = std::addressof(*branch);
+        }
+        return current_node;
+    }
+
+    template<typename Key>
+    static size_t key_length(const Key& key)
+    {
+        return static_cast<size_t>(std::distance(std::begin(key), std::end(key)));
+    }
+
+    template<typename Key>
+    static _Key_Piece piece_at(const Key& key, size_t depth)
+    {
+        return *std::next(std::begin(key), depth);
+    }
+
+    /********************************************************
+     * @brief Builds the subtree of root from the elements of
+     * [first, last), sorted by their keys piece by piece.
+     * Every node splits its range into one run per child
+     * first, so its children vector is reserved once and
+     * filled from the back. Returns the number of elements.
+     ********************************************************/
+    template<typename ForwardIt>
+    size_t build_sorted(node_type& root, ForwardIt first, ForwardIt last) const
+    {
+        struct run
+        {
+            node_type* node;
+            ForwardIt  first;
+            ForwardIt  last;
+            size_t     depth;
+        };
+
+        std::vector<run> pending{{&root, first, last, 0}};
+        std::vector<run> children;
+        size_t size = 0;
+
+        while(!pending.empty())
+        {
+            run current = pending.back();
+            pending.pop_back();
+
+            // Keys ending here sort first, a repeated key keeps its first value like emplace does
+            for(; current.first != current.last && key_length(current.first->first) == current.depth; ++current.first)
+            {
+                if(!current.node->value.has_value())
+                {
+                    current.node->value.emplace(current.first->second);
+                    count_added(current.node, &root);
+                    ++size;
+                }
+            }
+
+            // Keys sharing the piece at depth are next to each other and make up one child
+            children.clear();
+            for(ForwardIt it = current.first; it != current.last; ++it)
+            {
+                if(key_length(it->first) == current.depth)
+                    throw std::invalid_argument("trie::assign_sorted() was invoked with unsorted keys.");
+
+                if(!children.empty())
+                {
+                    _Key_Piece previous = piece_at(children.back().first->first, current.depth);
+                    _Key_Piece piece    = piece_at(it->first, current.depth);
+
+                    if(!_key_compare(previous, piece))
+                    {
+                        if(_key_compare(piece, previous))
+                            throw std::invalid_argument("trie::assign_sorted() was invoked with unsorted keys.");
+                        continue;
+                    }
+                    children.back().last = it;
+                }
+                children.push_back(run{nullptr, it, current.last, current.depth + 1});
+            }
+
+            current.node->reserve_children(children.size());
+            for(auto& child : children)
+                child.node = std::addressof(*current.node->emplace_child(current.node->children.cend(),
+                                                                         piece_at(child.first->first, current.depth),
+                                                                         current.node));
+
+            pending.insert(pending.end(), children.rbegin(), children.rend());
+        }
+        return size;
+    }
+
+    bool erase_node(node_type* node)
+    {
+        if(node == nullptr || !node->value.has_value())
+            return false;
+
+        node->value.reset();
+        --_size;
+
+        for(node_type* ancestor = node; ancestor != nullptr; ancestor = ancestor->parent)
+            --ancestor->subtree_size;
+
+        node_type* current_node = node;
+        node_type* parent = node->parent;
+        
+        while(current_node->children.empty() && !current_node->value.has_value() && current_node->parent != nullptr)
+        {
+            parent->erase_child(lower_bound_child(*parent, current_node->key_piece));
+            _Counters::free_node();
+            current_node = parent;
+            parent = current_node->parent;
+        }
+
+        return true;
+    }
+
+public:
+    /********************************* Constructors **********************************/
+    explicit trie(const key_concat&     concat,
+                  const key_compare&    compare   = key_compare{},
+                  const allocator_type& allocator = allocator_type{})
+
+        : _size{0}, _key_concat{concat}, _key_compare{compare},
+          _root{select_node_allocator(typename node_type::children_allocator(allocator), 0)}
+    {}
+
+    /***************************************
+     * Builds the trie from [first, last) of
+     * key-value pairs the way assign_sorted()
+     * does.
+    ****************************************/
+    template<typename ForwardIt>
+    trie(const key_concat&     concat,
+         ForwardIt             first,
+         ForwardIt             last,
+         const key_compare&    compare   = key_compare{},
+         const allocator_type& allocator = allocator_type{})
+
+        : trie(concat, compare, allocator)
+    {
+        assign_sorted(first, last);
+    }
+
+    trie(const trie&)     = default;
+    trie(trie&&) noexcept = default;
+    virtual ~trie()       = default;
+
+    /****************************** Assignment operators *****************************/
+
+    trie& operator=(const trie& other) = default;
+    trie& operator=(trie&&) noexcept   = default;
+
+    /*********************************************************************************/
+
+    /****************************** Public Functionality *****************************/
+    bool   empty() const noexcept { return _size == 0;  }
+    size_t size()  const noexcept { return _size;       } 
+
+    allocator_type get_allocator() const { return allocator_type(_root.children.get_allocator()); }
+
+    /***************************************
+     * Counters of the calling thread, kept
+     * by a _Counters policy such as
+     * thread_trie_counters. They read zero
+     * with no_trie_counters.
+    ****************************************/
+    static trie_counter_values counters() noexcept { return _Counters::read(); }
+    static void reset_counters()          noexcept { _Counters::reset();       }
+
+    /***************************************
+     * Bytes taken by the trie and its nodes,
+     * spare capacity of the children vectors
+     * included. Values count with their size,
+     * memory they own themselves does not.
+    ****************************************/
+    size_t memory_usage() const
+    {
+        size_t bytes = sizeof(*this);
+        for(std::vector<const node_type*> pending{&_root}; !pending.empty(); )
+        {
+            const node_type* current_node = pending.back();
+            pending.pop_back();
+
+            bytes += current_node->children.capacity() * sizeof(node_type) + current_node->keys_memory_usage();
+            for(const auto& child : current_node->children)
+                pending.push_back(&child);
+        }
+        return bytes;
+    }
+
+    /***************************************
+     * Shape of the trie and where its bytes
+     * go. node_bytes holds every node below
+     * the root, the packed child keys and
+     * the values in them included, so with
+     * slack_bytes and the trie itself it adds
+     * up to memory_usage().
+    ****************************************/
+    struct trie_stats
+    {
+        size_t node_count        = 0;  // The root included
+        size_t valued_node_count = 0;
+
+        std::vector<size_t> depth_histogram;   // Nodes at each depth, the root is at 0
+        std::vector<size_t> fanout_histogram;  // Nodes by their number of children
+
+        size_t node_bytes  = 0;
+        size_t slack_bytes = 0;  // Unused capacity of the children vectors
+        size_t value_bytes = 0;  // Part of node_bytes taken by values
+
+        double average_key_length = 0;  // In key pieces
+    };
+
+    trie_stats stats() const
+    {
+        trie_stats stats;
+        size_t key_pieces = 0;
+
+        for(std::vector<std::pair<const node_type*, size_t>> pending{{&_root, 0}}; !pending.empty(); )
+        {
+            auto [current_node, depth] = pending.back();
+            pending.pop_back();
+
+            size_t fanout = current_node->children.size();
+            if(depth >= stats.depth_histogram.size())
+                stats.depth_histogram.resize(depth + 1);
+            if(fanout >= stats.fanout_histogram.size())
+                stats.fanout_histogram.resize(fanout + 1);
+
+            ++stats.node_count;
+            ++stats.depth_histogram[depth];
+            ++stats.fanout_histogram[fanout];
+
+            if(current_node->value.has_value())
+            {
+                ++stats.valued_node_count;
+                key_pieces += depth;
+            }
+
+            stats.node_bytes  += fanout * sizeof(node_type) + current_node->keys_memory_usage();
+            stats.slack_bytes += (current_node->children.capacity() - fanout) * sizeof(node_type);
+
+            for(const auto& child : current_node->children)
+                pending.emplace_back(&child, depth + 1);
+        }
+
+        stats.value_bytes = stats.valued_node_count * sizeof(mapped_type);
+        if(stats.valued_node_count != 0)
+            stats.average_key_length = static_cast<double>(key_pieces) / stats.valued_node_count;
+
+        return stats;
+    }
+
+    /***************************************
+     * Invalidates all iterators !!
+     * Gives back the spare capacity of every
+     * children vector, which erase leaves in
+     * place. An arena_allocator only gets the
+     * memory back with clear().
+    ****************************************/
+    void shrink_to_fit()
+    {
+        for(std::vector<node_type*> pending{&_root}; !pending.empty(); )
+        {
+            node_type* current_node = pending.back();
+            pending.pop_back();
+
+            // Children settle before we step into them
+            current_node->shrink_children();
+            for(auto& child : current_node->children)
+                pending.push_back(&child);
+        }
+    }
+
+    /***************************************
+     * Invalidates all iterators !!
+     * Every node is released at once, an
+     * arena_allocator starts a new arena.
+    ****************************************/
+    void clear()
+    {
+        _root = node_type(select_node_allocator(_root.children.get_allocator(), 0));
+        _size = 0;
+    }
+
+    template<typename Key = key_type, if_key_range<Key> = 0>
+    size_t count(const Key& key) const
+    {
+        return (find(key) == cend()) ? 0 : 1;
+    }
+
+    /***************************************
+     * Invalidates all previous iterators !!
+    ****************************************/
+    template<typename Key, typename Value>
+    std::pair<iterator,bool> emplace(Key&& key, Value&& value)
+    {
+        node_type* current_node;
+
+        // Ranges of key pieces are walked as they are, anything else is made a key_type first
+        if constexpr(is_key_range<std::decay_t<Key>>::value)
+        {
+            auto&& pieces = key_pieces(key);
+            current_node = emplace_path(&_root, std::begin(pieces), std::end(pieces));
+        }
+        else
+        {
+            key_type emplaced_key(std::forward<Key>(key));
+            current_node = emplace_path(&_root, emplaced_key.begin(), emplaced_key.end());
+        }
+
+        bool emplaced = false;
+        if(!current_node->value.has_value())
+        {
+            current_node->value.emplace(std::forward<Value>(value));
+            count_added(current_node, &_root);
+            emplaced = true;
+            ++_size;
+        }
+
+        return std::make_pair(iterator(current_node, _key_concat),emplaced);
+    }
+
+    /***************************************
+     * Invalidates all previous iterators !!
+     * Emplaces the key-value pairs of [first,
+     * last) the way emplace would one after
+     * the other, on up to thread_count threads.
+     * Pairs are split by the first piece of
+     * their key and each subtree under the
+     * root is built by a single thread, the
+     * biggest ones first. The node allocator
+     * must be usable from several threads at
+     * once, which arena_allocator is not.
+     * If a pair fails to emplace the ones
+     * before it in its subtree stay, nodes
+     * left without value are removed. Work
+     * counted by _Counters on other threads
+     * is added to the calling thread's.
+    ****************************************/
+    template<typename ForwardIt>
+    void emplace_parallel(ForwardIt first, ForwardIt last,
+                          size_t thread_count = std::thread::hardware_concurrency())
+    {
+        try
+        {
+            emplace_partitioned(first, last, thread_count);
+        }
+        catch(...)
+        {
+            prune_empty(_root);
+            throw;
+        }
+    }
+
+    /***************************************
+     * Writes every element to out in one
+     * depth first pass over the nodes. Values
+     * go through codec.encode(out, value),
+     * key pieces are written as raw bytes.
+    ****************************************/
+    template<typename Codec>
+    void serialize(std::ostream& out, Codec&& codec) const
+    {
+        out.write(stream_magic, sizeof(stream_magic));
+        write_raw(out, std::uint32_t{sizeof(_Key_Piece)});
+        write_raw(out, std::uint64_t{_size});
+        write_node(out, _root, codec);
+
+        // Nodes on the path of the last written node, with the index of their next child
+        std::vector<std::pair<const node_type*, size_t>> path{{&_root, 0}};
+        while(!path.empty())
+        {
+            auto& [node, next_child] = path.back();
+
+            if(next_child == node->children.size())
+            {
+                path.pop_back();
+                continue;
+            }
+
+            const node_type& child = node->children[next_child++];
+            write_raw(out, child.key_piece);
+            write_node(out, child, codec);
+            path.emplace_back(&child, 0);
+        }
+
+        if(!out)
+            throw std::runtime_error("trie::serialize() could not write the trie.");
+    }
+
+    void serialize(std::ostream& out) const
+    {
+        serialize(out, raw_codec{});
+    }
+
+    /***************************************
+     * Invalidates all iterators !!
+     * Replaces the elements with the ones
+     * serialize() wrote to in. Nodes are
+     * appended in their final order, each
+     * children vector is allocated once.
+     * Values come from codec.decode(in).
+     * Throws std::runtime_error on malformed
+     * input and leaves the trie unchanged.
+    ****************************************/
+    template<typename Codec>
+    void deserialize(std::istream& in, Codec&& codec)
+    {
+        char magic[sizeof(stream_magic)];
+        std::uint32_t key_piece_size;
+        std::uint64_t size;
+
+        if(!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), stream_magic))
+            throw std::runtime_error("trie::deserialize() found no serialized trie.");
+
+        read_raw(in, key_piece_size);
+        read_raw(in, size);
+        if(key_piece_size != sizeof(_Key_Piece))
+            throw std::runtime_error("trie::deserialize() found a trie of other key pieces.");
+
+        node_type root(select_node_allocator(_root.children.get_allocator(), 0));
+
+        // Nodes on the path of the last read node, with the number of children still to read
+        std::vector<std::pair<node_type*, size_t>> path{{&root, read_node(in, root, codec)}};
+        size_t read_size = root.value.has_value() ? 1 : 0;
+
+        while(!path.empty())
+        {
+            auto& [node, remaining] = path.back();
+
+            // Every child is read by now, so the subtree is complete
+            if(remaining == 0)
+            {
+                node->subtree_size = node->value.has_value() ? 1 : 0;
+                for(const auto& child : node->children)
+                    node->subtree_size += child.subtree_size;
+
+                path.pop_back();
+                continue;
+            }
+            --remaining;
+
+            _Key_Piece key_piece;
+            read_raw(in, key_piece);
+
+            // Children come sorted, so each one is appended after its siblings
+            if(!node->children.empty() && !_key_compare(node->children.back().key_piece, key_piece))
+                throw std::runtime_error("trie::deserialize() found children out of order.");
+
+            node_type* child = std::addressof(*node->emplace_child(node->children.cend(), key_piece, node));
+            path.emplace_back(child, read_node(in, *child, codec));
+            read_size += child->value.has_value() ? 1 : 0;
+        }
+
+        if(read_size != size)
+            throw std::runtime_error("trie::deserialize() read a different number of elements than written.");
+
+        _root = std::move(root);
+        _size = read_size;
+    }
+
+    void deserialize(std::istream& in)
+    {
+        deserialize(in, raw_codec{});
+    }
+
+    /***************************************
+     * Invalidates all iterators !!
+     * Replaces the elements with the key-value
+     * pairs of [first, last), whose keys have
+     * to be sorted piece by piece with
+     * key_compare. Children are only ever
+     * appended and every children vector is
+     * allocated once. Use emplace for unsorted
+     * input, this throws std::invalid_argument
+     * on it and leaves the trie unchanged.
+    ****************************************/
+    template<typename ForwardIt>
+    void assign_sorted(ForwardIt first, ForwardIt last)
+    {
+        node_type root(select_node_allocator(_root.children.get_allocator(), 0));
+        size_t size = build_sorted(root, first, last);
+
+        _root = std::move(root);
+        _size = size;
+    }
+
+    /***************************************
+     * Invalidates all iterators !!
+    ****************************************/
+    template<typename Key = key_type, if_key_range<Key> = 0>
+    size_t erase(const Key& key)
+    {
+        return (erase_node(find_node(key))) ? 1 : 0;
+    }
+
+    /***************************************
+     * Invalidates all iterators !!
+    ****************************************/
+    void erase(iterator pos)
+    {
+        erase_node(pos._pointed_node);
+    }
+
+    template<typename Key = key_type, if_key_range<Key> = 0>
+    iterator find(const Key& key)
+    {
+        node_type* target = find_node(key);
+        return (target != nullptr && target->value.has_value()) ? iterator(target, _key_concat) : end();
+    }
+
+    template<typename Key = key_type, if_key_range<Key> = 0>
+    const_iterator find(const Key& key) const
+    {
+        const node_type* target = find_node(key);
+        return (target != nullptr && target->value.has_value()) ? const_iterator(target, _key_concat) : cend();
+    }
+
+    /***************************************
+     * Looks up every key of [first, last) and
+     * writes one iterator per key to out, end()
+     * for the missing ones. The keys descend
+     * the trie side by side, which hides much
+     * of the memory latency of large tries.
+     * Keys may be any ranges find takes and
+     * are not converted to key_type. They are
+     * read in place, so the iterators have to
+     * be forward iterators to stored keys.
+    ****************************************/
+    template<typename ForwardIt, typename OutputIt>
+    OutputIt find_batch(ForwardIt first, ForwardIt last, OutputIt out)
+    {
+        find_nodes(first, last, [&](const node_type* target)
+        {
+            *out++ = (target != nullptr) ? iterator(const_cast<node_type*>(target), _key_concat) : end();
+        });
+        return out;
+    }
+
+    template<typename ForwardIt, typename OutputIt>
+    OutputIt find_batch(ForwardIt first, ForwardIt last, OutputIt out) const
+    {
+        find_nodes(first, last, [&](const node_type* target)
+        {
+            *out++ = (target != nullptr) ? const_iterator(target, _key_concat) : cend();
+        });
+        return out;
+    }
+
+    /***************************************
+     * Element with the longest key that is
+     * a prefix of key, end() if there's none.
+    ****************************************/
+    template<typename Key = key_type, if_key_range<Key> = 0>
+    iterator longest_prefix_match(const Key& key)
+    {
+        node_type* target = find_longest_prefix(key);
+        return (target != nullptr) ? iterator(target, _key_concat) : end();
+    }
+
+    template<typename Key = key_type, if_key_range<Key> = 0>
+    const_iterator longest_prefix_match(const Key& key) const
+    {
+        const node_type* target = find_longest_prefix(key);
+        return (target != nullptr) ? const_iterator(target, _key_concat) : cend();
+    }
+
+    /***************************************
+     * Number of elements whose key is less
+     * than key, which need not be stored.
+     * Takes one descent, summing the subtree
+     * sizes of the siblings passed on the way.
+    ****************************************/
+    template<typename Key = key_type, if_key_range<Key> = 0>
+    size_t rank(const Key& key) const
+    {
+        const node_type* current_node = &_root;
+        size_t less = 0;
+
+        for(const auto& key_piece : key_pieces(key))
+        {
+            // A value on the way belongs to a proper prefix of key
+            if(current_node->value.has_value())
+                ++less;
+
+            auto branch = lower_bound_child(*current_node, key_piece);
+            for(auto child = current_node->children.begin(); child != branch; ++child)
+                less += child->subtree_size;
+
+            if(branch == current_node->children.end() || piece_less(key_piece, branch->key_piece))
+                return less;
+
+            current_node = std::addressof(*branch);
+        }
+        return less;
+    }
+
+    /***************************************
+     * Element with index k in key order,
+     * end() if there are no more than k.
+    ****************************************/
+    iterator select(size_t k)
+    {
+        const node_type* target = select_node(k);
+        return (target != nullptr) ? iterator(const_cast<node_type*>(target), _key_concat) : end();
+    }
+
+    const_iterator select(size_t k) const
+    {
+        const node_type* target = select_node(k);
+        return (target != nullptr) ? const_iterator(target, _key_concat) : cend();
+    }
+
+    // Number of elements whose key starts with prefix
+    template<typename Key = key_type, if_key_range<Key> = 0>
+    size_t count_prefix(const Key& prefix) const
+    {
+        const node_type* subtree = find_node(prefix);
+        return (subtree != nullptr) ? subtree->subtree_size : 0;
+    }
+
+    /***************************************
+     * Range of every element whose key
+     * starts with prefix, in key order.
+    ****************************************/
+    template<typename Key = key_type, if_key_range<Key> = 0>
+    std::pair<iterator,iterator> prefix_range(const Key& prefix)
+    {
+        node_type* subtree = find_node(prefix);
+
+        if(subtree == nullptr || empty())
+            return std::make_pair(end(), end());
+
+        return std::make_pair(iterator(subtree->first_valued(), _key_concat),
+                              iterator(subtree->skip_subtree(), _key_concat));
+    }
+
+    template<typename Key = key_type, if_key_range<Key> = 0>
+    std::pair<const_iterator,const_iterator> prefix_range(const Key& prefix) const
+    {
+        const node_type* subtree = find_node(prefix);
+
+        if(subtree == nullptr || empty())
+            return std::make_pair(cend(), cend());
+
+        return std::make_pair(const_iterator(subtree->first_valued(), _key_concat),
+                              const_iterator(subtree->skip_subtree(), _key_concat));
+    }
+
+    /***************************************
+     * Calls function with the value of every
+     * element whose key starts with prefix,
+     * in key order. Keys are never built.
+    ****************************************/
+    template<typename Key = key_type, typename Function, if_key_range<Key> = 0>
+    void for_each_prefix(const Key& prefix, Function&& function)
+    {
+        node_type* subtree = find_node(prefix);
+
+        if(subtree == nullptr || empty())
+            return;
+
+        for(node_type *current_node = subtree->first_valued(), *last = subtree->skip_subtree();
+            current_node != last; current_node = current_node->next_node())
+            function(current_node->value.value());
+    }
+
+    template<typename Key = key_type, typename Function, if_key_range<Key> = 0>
+    void for_each_prefix(const Key& prefix, Function&& function) const
+    {
+        const node_type* subtree = find_node(prefix);
+
+        if(subtree == nullptr || empty())
+            return;
+
+        for(const node_type *current_node = subtree->first_valued(), *last = subtree->skip_subtree();
+            current_node != last; current_node = current_node->next_node())
+            function(std::as_const(current_node->value.value()));
+    }
+
+    /***************************************
+     * Calls function(key, value) for every
+     * element on up to thread_count threads,
+     * concurrently and in no particular order.
+     * The trie is split into subtrees, the
+     * biggest ones split further, until every
+     * thread has several to work through.
+    ****************************************/
+    template<typename Function>
+    void parallel_for_each(Function&& function,
+                           size_t thread_count = std::thread::hardware_concurrency())
+    {
+        static_cast<const trie*>(this)->parallel_for_each([&](const key_type& key, const mapped_type& value)
+        {
+            function(key, const_cast<mapped_type&>(value));
+        }, thread_count);
+    }
+
+    template<typename Function>
+    void parallel_for_each(Function&& function,
+                           size_t thread_count = std::thread::hardware_concurrency()) const
+    {
+        if(empty())
+            return;
+
+        auto tasks = split_traversal(std::max<size_t>(thread_count, 1) * tasks_per_thread);
+        run_traversal(tasks, thread_count, [&](size_t, auto&& walk)
+        {
+            walk([&](const key_type& key, const node_type& node){ function(key, node.value.value()); });
+        });
+    }
+
+    enum class traversal_order { any, key };
+
+    /***************************************
+     * Folds map(key, value) of every element
+     * into init with reduce(lhs, rhs), on up
+     * to thread_count threads. Each task folds
+     * its own elements in key order. With
+     * traversal_order::any their results are
+     * folded in as tasks finish, so reduce has
+     * to be commutative too. With
+     * traversal_order::key they are folded in
+     * key order, which gives the result of a
+     * sequential fold for any associative
+     * reduce.
+    ****************************************/
+    template<typename T, typename Map, typename Reduce>
+    T parallel_reduce(T init, Map&& map, Reduce&& reduce,
+                      traversal_order order = traversal_order::any,
+                      size_t thread_count = std::thread::hardware_concurrency()) const
+    {
+        if(empty())
+            return init;
+
+        auto tasks = split_traversal(std::max<size_t>(thread_count, 1) * tasks_per_thread);
+
+        std::vector<std::optional<T>> results(order == traversal_order::key ? tasks.size() : 0);
+        std::mutex result_mutex;
+
+        run_traversal(tasks, thread_count, [&](size_t index, auto&& walk)
+        {
+            std::optional<T> result;
+            walk([&](const key_type& key, const node_type& node)
+            {
+                if(result.has_value())
+                    result.value() = reduce(std::move(result.value()), map(key, node.value.value()));
+                else
+                    result.emplace(map(key, node.value.value()));
+            });
+
+            if(order == traversal_order::key)
+                results[index] = std::move(result);
+            else if(result.has_value())
+            {
+                std::lock_guard<std::mutex> lock(result_mutex);
+                init = reduce(std::move(init), std::move(result.value()));
+            }
+        });
+
+        for(auto& result : results)
+            if(result.has_value())
+                init = reduce(std::move(init), std::move(result.value()));
+
+        return init;
     }
 
-    mapped_type& at(const key_type& key)
+    template<typename Key = key_type, if_key_range<Key> = 0>
+    mapped_type& at(const Key& key)
     {
         node_type* target = find_node(key);
         
@@ -623,7 +2125,8 @@ public:
             throw std::out_of_range("trie::at() was invoked with key that is not stored.");
     }
 
-    const mapped_type& at(const key_type& key) const
+    template<typename Key = key_type, if_key_range<Key> = 0>
+    const mapped_type& at(const Key& key) const
     {
         const node_type* target = find_node(key);
         
@@ -633,7 +2136,8 @@ public:
             throw std::out_of_range("trie::at() was invoked with key that is not stored.");
     }
 
-    std::optional<std::reference_wrapper<mapped_type>> operator[](const key_type& key)
+    template<typename Key = key_type, if_key_range<Key> = 0>
+    std::optional<std::reference_wrapper<mapped_type>> operator[](const Key& key)
     {
         node_type* target = find_node(key);
 
@@ -641,7 +2145,8 @@ public:
                     ? std::optional(std::ref(target->value.value())) : std::nullopt;
     }
 
-    const std::optional<std::reference_wrapper<const mapped_type>> operator[](const key_type& key) const
+    template<typename Key = key_type, if_key_range<Key> = 0>
+    const std::optional<std::reference_wrapper<const mapped_type>> operator[](const Key& key) const
     {
         const node_type* target = find_node(key);
 
@@ -652,10 +2157,9 @@ public:
 private:
 
     size_t _size;
-    key_concat   _key_concat;
-    key_compare  _key_compare;
-    node_compare _node_compare;
-    node_type    _root;
+    key_concat  _key_concat;
+    key_compare _key_compare;
+    node_type   _root;
 };
 
 #endif /* GENERIC_TRIE__H */
@@ -0,0 +1,471 @@
+#ifndef PERSISTENT_TRIE__H
+#define PERSISTENT_TRIE__H
+
+#include <utility>
+#include <optional>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <iterator>
+#include <functional>
+#include <type_traits>
+
+#include "trie_iterator.h"
+
+/********************************************************
+ * @brief Immutable variant of the generic trie whose
+ * versions share structure.
+ *
+ * Nodes are reference counted and never change once
+ * built. emplace, insert_or_assign and erase leave the
+ * trie alone and return a new version, which holds
+ * copies of the nodes on the path of the key and shares
+ * every other subtree with the original. An update costs
+ * O(key length) nodes, copying a version costs nothing.
+ *
+ * Nodes don't know their parent, since they can have
+ * many, so iterators keep the path they walked instead.
+ * They also hold the root and a copy of the concat, so
+ * they stay valid after the version they came from dies.
+ ********************************************************/
+template<typename _Key_Piece,
+         typename _Tp,
+         typename _Concat,
+         template <typename> class _Compare = std::less,
+         template <typename,
+                   typename,
+                   typename> class _Key     = std::basic_string,
+         template <typename> class _Traits  = std::char_traits,
+         template <typename> class _Alloc   = std::allocator>
+
+class persistent_trie
+{
+
+protected:
+    struct persistent_node;
+
+public:
+    class const_iterator;
+    using iterator = const_iterator;
+
+public:
+    /********************************* Member types **********************************/
+    using key_type    = _Key<_Key_Piece, _Traits<_Key_Piece>, _Alloc<_Key_Piece>>;
+    using key_compare = _Compare<_Key_Piece>;
+    using key_concat  = _Concat;
+    using mapped_type = _Tp;
+    using value_type  = std::pair<const key_type, const mapped_type&>;
+    using node_type   = persistent_node;
+    using allocator_type = _Alloc<_Key_Piece>;
+    /*********************************************************************************/
+
+protected:
+    /******************************** Member classes ********************************/
+    using node_pointer = std::shared_ptr<const persistent_node>;
+
+    struct persistent_node
+    {
+        using child_type         = std::pair<_Key_Piece, node_pointer>;
+        using children_allocator = _Alloc<child_type>;
+        using children_type      = std::vector<child_type, children_allocator>;
+
+        std::optional<mapped_type> value;
+        children_type children;   // Sorted by key piece
+
+        explicit persistent_node(const children_allocator& allocator)
+            : children(allocator) {}
+    };
+
+public:
+    /***************************************** Iterator *******************************************/
+    class const_iterator
+    {
+        friend class persistent_trie;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = persistent_trie::value_type;
+        using pointer           = arrow_proxy<value_type>;
+        using reference         = value_type;
+
+        explicit const_iterator(const key_concat& concat, node_pointer root = nullptr)
+            : _root(std::move(root)), _concat(std::in_place, concat) {}
+
+        const_iterator(const const_iterator&)            = default;
+        const_iterator(const_iterator&&) noexcept        = default;
+        virtual ~const_iterator()                        = default;
+
+        // Closures can be copied but not assigned, so the concat is copied in anew
+        const_iterator& operator=(const const_iterator& other)
+        {
+            if(this != &other)
+            {
+                _path = other._path;
+                _root = other._root;
+                _concat.emplace(*other._concat);
+            }
+            return *this;
+        }
+
+        const_iterator& operator=(const_iterator&& other) noexcept(std::is_nothrow_copy_constructible<concat_holder>::value)
+        {
+            _path = std::move(other._path);
+            _root = std::move(other._root);
+            _concat.emplace(*other._concat);
+            return *this;
+        }
+
+        reference operator* () const
+        {
+            return value_type(trace_key(), _path.back().first->value.value());
+        }
+
+        pointer operator->() const
+        {
+            return pointer{value_type(trace_key(), _path.back().first->value.value())};
+        }
+
+        const_iterator& operator++()
+        {
+            const node_type* current_node = _path.back().first;
+
+            if(!current_node->children.empty())
+            {
+                _path.emplace_back(current_node->children.front().second.get(), 0);
+                first_valued();
+                return *this;
+            }
+
+            // Going up while we are the last child, then over to the next sibling
+            while(_path.size() > 1)
+            {
+                size_t index = _path.back().second;
+                _path.pop_back();
+
+                const node_type* parent = _path.back().first;
+                if(index + 1 < parent->children.size())
+                {
+                    _path.emplace_back(parent->children[index + 1].second.get(), index + 1);
+                    first_valued();
+                    return *this;
+                }
+            }
+
+            _path.clear();
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator no_op = *this;
+            ++(*this);
+            return no_op;
+        }
+
+        friend bool operator==(const const_iterator& lhs, const const_iterator& rhs)
+        {
+            return lhs._path.empty() ? rhs._path.empty() : (!rhs._path.empty() && lhs._path.back() == rhs._path.back());
+        }
+
+        friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs) { return !(lhs == rhs); }
+
+    private:
+        void first_valued()
+        {
+            while(!_path.back().first->value.has_value())
+                _path.emplace_back(_path.back().first->children.front().second.get(), 0);
+        }
+
+        key_type trace_key() const
+        {
+            key_type key;
+            for(size_t depth = 1; depth < _path.size(); ++depth)
+                (*_concat)(key, _path[depth - 1].first->children[_path[depth].second].first);
+
+            return key;
+        }
+
+        // A reference concat is kept as a reference, anything else as a copy
+        using concat_holder = std::conditional_t<std::is_reference<key_concat>::value,
+                                                 std::reference_wrapper<std::remove_reference_t<key_concat>>,
+                                                 key_concat>;
+
+        // Nodes from the root down, each with its index among its parent's children
+        std::vector<std::pair<const node_type*, size_t>> _path;
+        node_pointer                 _root;
+        std::optional<concat_holder> _concat;
+    };
+
+    // ITERATORS
+    const_iterator begin() const
+    {
+        const_iterator it(_key_concat, _root);
+
+        if(!empty())
+        {
+            it._path.emplace_back(_root.get(), 0);
+            it.first_valued();
+        }
+        return it;
+    }
+
+    const_iterator end()    const noexcept { return const_iterator(_key_concat); }
+
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend()   const noexcept { return end(); }
+
+private:
+    /*************************************** Private Functionality ******************************************/
+
+    std::shared_ptr<persistent_node> create_node() const
+    {
+        return std::allocate_shared<persistent_node>(_Alloc<persistent_node>(_allocator),
+                                                     typename persistent_node::children_allocator(_allocator));
+    }
+
+    std::shared_ptr<persistent_node> copy_node(const node_type* node) const
+    {
+        std::shared_ptr<persistent_node> copy = create_node();
+
+        copy->value    = node->value;
+        copy->children = node->children;
+
+        return copy;
+    }
+
+    template<typename Node>
+    auto lower_bound_child(Node& node, const _Key_Piece& key_piece) const
+    {
+        return std::lower_bound(node.children.begin(), node.children.end(), key_piece,
+                                [&](const auto& child, const _Key_Piece& piece) { return _key_compare(child.first, piece); });
+    }
+
+    // Nodes on the path of key that exist in this version, root first
+    std::vector<const node_type*> existing_path(const key_type& key) const
+    {
+        std::vector<const node_type*> path{_root.get()};
+        for(const auto& key_piece : key)
+        {
+            auto branch = lower_bound_child(*path.back(), key_piece);
+
+            if(branch == path.back()->children.end() || _key_compare(key_piece, branch->first))
+                break;
+
+            path.push_back(branch->second.get());
+        }
+        return path;
+    }
+
+    const node_type* find_node(const key_type& key) const
+    {
+        std::vector<const node_type*> path = existing_path(key);
+        return (path.size() == key.size() + 1) ? path.back() : nullptr;
+    }
+
+    /********************************************************
+     * @brief Root of a version in which the node for key
+     * piece path.size() - 1 is replaced by child, or
+     * dropped if child is nullptr. Copies every node of
+     * path, pass-through nodes left without children are
+     * dropped as well, except for the root.
+     ********************************************************/
+    node_pointer copy_path(const std::vector<const node_type*>& path, const key_type& key, node_pointer child) const
+    {
+        for(size_t depth = path.size(); depth-- > 0; )
+        {
+            std::shared_ptr<persistent_node> copy = copy_node(path[depth]);
+
+            auto branch = lower_bound_child(*copy, key[depth]);
+            bool linked = branch != copy->children.end() && !_key_compare(key[depth], branch->first);
+
+            if(child != nullptr && linked)
+                branch->second = std::move(child);
+            else if(child != nullptr)
+                copy->children.emplace(branch, key[depth], std::move(child));
+            else if(linked)
+                copy->children.erase(branch);
+
+            if(depth > 0 && copy->children.empty() && !copy->value.has_value())
+                child = nullptr;
+            else
+                child = std::move(copy);
+        }
+
+        return (child != nullptr) ? child : create_node();
+    }
+
+    // Version with the value of key set by assign, the nodes missing from its path are created
+    template<typename Assign>
+    persistent_trie updated(const key_type& key, Assign&& assign) const
+    {
+        std::vector<const node_type*> path = existing_path(key);
+        std::shared_ptr<persistent_node> target;
+
+        if(path.size() == key.size() + 1)
+        {
+            target = copy_node(path.back());
+            path.pop_back();
+        }
+        else
+            target = create_node();
+
+        bool emplaced = !target->value.has_value();
+        assign(target->value);
+
+        node_pointer child = std::move(target);
+        for(size_t depth = key.size(); depth-- > path.size(); )
+        {
+            std::shared_ptr<persistent_node> parent = create_node();
+
+            parent->children.emplace_back(key[depth], std::move(child));
+            child = std::move(parent);
+        }
+
+        persistent_trie version(*this);
+        version._root  = copy_path(path, key, std::move(child));
+        version._size += emplaced ? 1 : 0;
+
+        return version;
+    }
+
+public:
+    /********************************* Constructors **********************************/
+    explicit persistent_trie(const key_concat&     concat,
+                             const key_compare&    compare   = key_compare{},
+                             const allocator_type& allocator = allocator_type{})
+
+        : _size{0}, _key_concat{concat}, _key_compare{compare}, _allocator{allocator}
+    {
+        _root = create_node();
+    }
+
+    // Copies share every node, they are snapshots
+    persistent_trie(const persistent_trie&)     = default;
+    persistent_trie(persistent_trie&&) noexcept = default;
+    virtual ~persistent_trie()                  = default;
+
+    /****************************** Assignment operators *****************************/
+
+    persistent_trie& operator=(const persistent_trie& other) = default;
+    persistent_trie& operator=(persistent_trie&&) noexcept   = default;
+
+    /*********************************************************************************/
+
+    /****************************** Public Functionality *****************************/
+    bool   empty() const noexcept { return _size == 0;  }
+    size_t size()  const noexcept { return _size;       }
+
+    allocator_type get_allocator() const { return _allocator; }
+
+    size_t count(const key_type& key) const
+    {
+        const node_type* target = find_node(key);
+        return (target != nullptr && target->value.has_value()) ? 1 : 0;
+    }
+
+    /***************************************
+     * Version with key added, or this very
+     * version if key was already stored.
+    ****************************************/
+    template<typename Key, typename Value>
+    persistent_trie emplace(Key&& key, Value&& value) const
+    {
+        const key_type local_key(std::forward<Key>(key));
+
+        if(count(local_key) != 0)
+            return *this;
+
+        return updated(local_key, [&](std::optional<mapped_type>& stored) { stored.emplace(std::forward<Value>(value)); });
+    }
+
+    /***************************************
+     * Version with value stored for key,
+     * replacing the one it had if any.
+    ****************************************/
+    template<typename Key, typename Value>
+    persistent_trie insert_or_assign(Key&& key, Value&& value) const
+    {
+        const key_type local_key(std::forward<Key>(key));
+
+        return updated(local_key, [&](std::optional<mapped_type>& stored) { stored = std::forward<Value>(value); });
+    }
+
+    /***************************************
+     * Version without key, or this very
+     * version if key was not stored.
+    ****************************************/
+    persistent_trie erase(const key_type& key) const
+    {
+        std::vector<const node_type*> path = existing_path(key);
+
+        if(path.size() != key.size() + 1 || !path.back()->value.has_value())
+            return *this;
+
+        // Without children the node goes away instead of losing its value
+        std::shared_ptr<persistent_node> child;
+        if(!path.back()->children.empty())
+        {
+            child = copy_node(path.back());
+            child->value.reset();
+        }
+        path.pop_back();
+
+        persistent_trie version(*this);
+        version._root = copy_path(path, key, std::move(child));
+        --version._size;
+
+        return version;
+    }
+
+    const_iterator find(const key_type& key) const
+    {
+        const_iterator it(_key_concat, _root);
+        it._path.emplace_back(_root.get(), 0);
+
+        for(const auto& key_piece : key)
+        {
+            const node_type* current_node = it._path.back().first;
+            auto branch = lower_bound_child(*current_node, key_piece);
+
+            if(branch == current_node->children.end() || _key_compare(key_piece, branch->first))
+                return end();
+
+            it._path.emplace_back(branch->second.get(), branch - current_node->children.begin());
+        }
+
+        return it._path.back().first->value.has_value() ? it : end();
+    }
+
+    const mapped_type& at(const key_type& key) const
+    {
+        const node_type* target = find_node(key);
+
+        if(target != nullptr && target->value.has_value())
+            return target->value.value();
+        else
+            throw std::out_of_range("persistent_trie::at() was invoked with key that is not stored.");
+    }
+
+    const std::optional<std::reference_wrapper<const mapped_type>> operator[](const key_type& key) const
+    {
+        const node_type* target = find_node(key);
+
+        return (target != nullptr && target->value.has_value())
+                    ? std::optional(std::cref(target->value.value())) : std::nullopt;
+    }
+
+    // True if both versions are the very same, which is cheaper than comparing elements
+    bool shares_root_with(const persistent_trie& other) const noexcept { return _root == other._root; }
+
+private:
+
+    size_t _size;
+    key_concat     _key_concat;
+    key_compare    _key_compare;
+    allocator_type _allocator;
+    node_pointer   _root;
+};
+
+#endif /* PERSISTENT_TRIE__H */
@@ -0,0 +1,627 @@
+#ifndef RADIX_TRIE__H
+#define RADIX_TRIE__H
+
+#include <utility>
+#include <optional>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <iterator>
+
+#include "trie_iterator.h"
+
+/********************************************************
+ * @brief Path compressed (radix / Patricia) variant of
+ * the generic trie.
+ *
+ * Every node holds the whole edge label leading to it as
+ * a key_type instead of a single key piece, so chains of
+ * single child nodes collapse into one node. Nodes are
+ * split when a key diverges in the middle of a label and
+ * merged back with their only child when erasing leaves
+ * them without a value.
+ ********************************************************/
+template<typename _Key_Piece,
+         typename _Tp,
+         typename _Concat,
+         template <typename> class _Compare = std::less,
+         template <typename,
+                   typename,
+                   typename> class _Key     = std::basic_string,
+         template <typename> class _Traits  = std::char_traits,
+         template <typename> class _Alloc   = std::allocator>
+
+class radix_trie
+{
+
+protected:
+    struct radix_node;
+
+public:
+    class iterator;
+    class const_iterator;
+
+public:
+    /********************************* Member types **********************************/
+    using key_type    = _Key<_Key_Piece, _Traits<_Key_Piece>, _Alloc<_Key_Piece>>;
+    using key_compare = _Compare<_Key_Piece>;
+    using key_concat  = _Concat;
+    using mapped_type = _Tp;
+    using value_type  = std::pair<const key_type, mapped_type&>;
+    using node_type   = radix_node;
+    /*********************************************************************************/
+
+protected:
+    /******************************** Member classes ********************************/
+    struct radix_node
+    {
+        key_type label;
+        std::optional<mapped_type> value;
+
+        radix_node* parent;
+        std::vector<radix_node> children;
+
+    /*********************************** Constructors ****************************************************/
+
+        explicit radix_node(node_type* parent = nullptr)
+            : label{}, parent(parent)
+        {}
+
+        explicit radix_node(key_type&& label,
+                            node_type* parent = nullptr)
+            : label(std::move(label)), parent(parent)
+        {}
+
+        ~radix_node() = default;
+
+        radix_node(const radix_node& other)
+            : label(other.label), value(other.value),
+              parent(other.parent), children(other.children)
+        {
+            // Revalidate parent pointers since copy invalidated it
+            adopt_children();
+        }
+
+        radix_node(radix_node&& other) noexcept
+            : label(std::move(other.label)), value(std::move(other.value)),
+              parent(std::move(other.parent)), children(std::move(other.children))
+        {
+            // Revalidate parent pointers since move invalidated it
+            adopt_children();
+        }
+
+        /************************************ Assignment ****************************************/
+        radix_node& operator=(const radix_node& other)
+        {
+            this->label    = other.label;
+            this->value    = other.value;
+            this->children = other.children;
+            this->parent   = other.parent;
+
+            // Revalidate parent pointers since copy invalidated it
+            adopt_children();
+
+            return *this;
+        }
+
+        radix_node& operator=(radix_node&& other) noexcept
+        {
+            this->label    = std::move(other.label);
+            this->value    = std::move(other.value);
+            this->children = std::move(other.children);
+            this->parent   = std::move(other.parent);
+
+            // Revalidate parent pointers since move invalidated it
+            adopt_children();
+
+            return *this;
+        }
+
+        /****************************************** Functionality *********************************/
+        void adopt_children()
+        {
+            for(auto& child : children)
+                child.parent = this;
+        }
+
+        const node_type* next_node() const
+        {
+            const node_type* current_node = this;
+
+            // True -> We can't go deeper the tree
+            if(current_node->children.empty() && current_node->parent != nullptr)
+            {
+                // Going up while we are the last child
+                while(current_node == &current_node->parent->children.back())
+                {
+                    current_node = current_node->parent;
+
+                    // There's nowhere to move if node has no parent nor sibling
+                    if(current_node->parent == nullptr)
+                        return nullptr;
+                }
+
+                // Siblings are stored next to each other
+                current_node = current_node + 1;
+            }
+            // There is no next node if root (node with no parent) has no children
+            else if(current_node->children.empty() && current_node->parent == nullptr)
+                return nullptr;
+            // If node has child we select that branch
+            else
+                current_node = &this->children.front();
+
+            // Expanding first child until we have one with value
+            while(!current_node->value.has_value())
+                current_node = &current_node->children.front();
+
+            return current_node;
+        }
+
+        node_type* next_node()
+        {
+            return const_cast<node_type*>(static_cast<const radix_node*>(this)->next_node());
+        }
+
+        const node_type* previous_node() const
+        {
+            const node_type* current_node = this;
+
+            // If we cannot go up we are first
+            if(current_node->parent == nullptr)
+                return nullptr;
+
+            // Moving up while we are the first child
+            while(current_node == &current_node->parent->children.front())
+            {
+                current_node = current_node->parent;
+
+                if(current_node->value.has_value())
+                    return current_node;
+
+                if(current_node->parent == nullptr)
+                    return nullptr;
+            }
+
+            // Find rightmost node of left sibling
+            current_node = current_node - 1;
+            while(!current_node->children.empty())
+                current_node = &current_node->children.back();
+
+            return current_node;
+        }
+
+        node_type* previous_node()
+        {
+            return const_cast<node_type*>(static_cast<const radix_node*>(this)->previous_node());
+        }
+
+        key_type trace_key(const key_concat& concat) const
+        {
+            std::vector<const radix_node*> reversed_path;
+            for(const radix_node* current_node = this; current_node->parent != nullptr; current_node = current_node->parent)
+                reversed_path.push_back(current_node);
+
+            key_type key;
+            for(auto it = reversed_path.rbegin(); it != reversed_path.rend(); ++it)
+                for(const auto& key_piece : (*it)->label)
+                    concat(key, key_piece);
+
+            return key;
+        }
+    };
+
+public:
+    /***************************************** Iterator *******************************************/
+    class iterator
+    {
+        friend class const_iterator;
+        friend class radix_trie;
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = radix_trie::value_type;
+        using pointer           = arrow_proxy<value_type>;
+        using reference         = value_type;
+
+        explicit iterator(node_type* ptr, const key_concat& concat)
+            :  _pointed_node(ptr), _concat(concat) {}
+
+        iterator(const iterator&)            = default;
+        iterator(iterator&&) noexcept        = default;
+        virtual ~iterator()                  = default;
+
+        reference operator* () const
+        {
+            return value_type(_pointed_node->trace_key(_concat), _pointed_node->value.value());
+        }
+
+        pointer operator->() const
+        {
+            return pointer{value_type(_pointed_node->trace_key(_concat),_pointed_node->value.value())};
+        }
+
+        iterator& operator++()
+        {
+            _pointed_node = _pointed_node->next_node();
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator no_op = *this;
+            ++(*this);
+            return no_op;
+        }
+
+        iterator& operator--()
+        {
+            _pointed_node = _pointed_node->previous_node();
+            return *this;
+        }
+
+        iterator operator--(int)
+        {
+            iterator no_op = *this;
+            --(*this);
+            return no_op;
+        }
+
+        friend bool operator==(const iterator& lhs, const iterator& rhs) { return lhs._pointed_node == rhs._pointed_node; }
+        friend bool operator!=(const iterator& lhs, const iterator& rhs) { return !(lhs == rhs); }
+
+    private:
+        node_type* _pointed_node;
+        const key_concat& _concat;
+    };
+
+    class const_iterator
+    {
+        friend class radix_trie;
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = std::pair<const radix_trie::key_type, const mapped_type&>;
+        using pointer           = arrow_proxy<value_type>;
+        using reference         = value_type;
+
+        explicit const_iterator(const node_type* ptr, const key_concat& concat)
+            : _pointed_node(ptr), _concat(concat) {}
+
+        // We are allowing implicit conversion from iterator -> const interator
+        const_iterator(const iterator& it)
+            : _pointed_node(it._pointed_node),
+              _concat(it._concat) {}
+
+        virtual ~const_iterator()                        = default;
+        const_iterator(const const_iterator&)            = default;
+        const_iterator(const_iterator&&) noexcept        = default;
+
+        reference operator* () const
+        {
+            return value_type(_pointed_node->trace_key(_concat), _pointed_node->value.value());
+        }
+
+        pointer operator->() const
+        {
+            return pointer{value_type(_pointed_node->trace_key(_concat),_pointed_node->value.value())};
+        }
+
+        const_iterator& operator++()
+        {
+            _pointed_node = _pointed_node->next_node();
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator no_op = *this;
+            ++(*this);
+            return no_op;
+        }
+
+        const_iterator& operator--()
+        {
+            _pointed_node = _pointed_node->previous_node();
+            return *this;
+        }
+
+        const_iterator operator--(int)
+        {
+            const_iterator no_op = *this;
+            --(*this);
+            return no_op;
+        }
+
+        friend bool operator==(const const_iterator& lhs, const const_iterator& rhs) { return lhs._pointed_node == rhs._pointed_node; }
+        friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs) { return !(lhs == rhs); }
+
+    private:
+        const node_type* _pointed_node;
+        const key_concat& _concat;
+    };
+
+    // ITERATORS
+    iterator begin() noexcept
+    {
+        return (_size == 0) ? end() : iterator(first_valued(&_root), _key_concat);
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return (_size == 0) ? end() : const_iterator(first_valued(&_root), _key_concat);
+    }
+
+    iterator       end()          noexcept { return iterator(nullptr, _key_concat);       }
+    const_iterator end()    const noexcept { return const_iterator(nullptr, _key_concat); }
+
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend()   const noexcept { return end();   }
+
+private:
+    /*************************************** Private Functionality ******************************************/
+
+    template<typename Node>
+    static Node* first_valued(Node* current_node)
+    {
+        while(!current_node->value.has_value())
+            current_node = &current_node->children.front();
+
+        return current_node;
+    }
+
+    bool equivalent(const _Key_Piece& lhs, const _Key_Piece& rhs) const
+    {
+        return !_key_compare(lhs, rhs) && !_key_compare(rhs, lhs);
+    }
+
+    /********************************************************
+     * @brief Binary searches the child whose label starts
+     * with a piece not less than key_piece. Children never
+     * share their first piece, and are kept sorted by it.
+     ********************************************************/
+    template<typename Node>
+    auto lower_bound_child(Node& node, const _Key_Piece& key_piece) const
+    {
+        return std::lower_bound(node.children.begin(), node.children.end(), key_piece,
+                                [&](const node_type& child, const _Key_Piece& piece) { return _key_compare(child.label.front(), piece); });
+    }
+
+    // Number of leading pieces label shares with key starting from offset
+    size_t common_prefix(const key_type& label, const key_type& key, size_t offset) const
+    {
+        size_t length = 0;
+        while(length < label.size() && offset + length < key.size() &&
+              equivalent(label[length], key[offset + length]))
+            ++length;
+
+        return length;
+    }
+
+    const node_type* find_node(const key_type& key) const
+    {
+        const node_type* current_node = &_root;
+        for(size_t offset = 0; offset < key.size(); )
+        {
+            auto branch = lower_bound_child(*current_node, key[offset]);
+
+            if(branch == current_node->children.end() ||
+               common_prefix(branch->label, key, offset) != branch->label.size())
+                return nullptr;
+
+            offset      += branch->label.size();
+            current_node = std::addressof(*branch);
+        }
+        return current_node;
+    }
+
+    node_type* find_node(const key_type& key)
+    {
+        return const_cast<node_type*>(static_cast<const radix_trie*>(this)->find_node(key));
+    }
+
+    // Collapses node into its only child if it became a pass-through node
+    static void merge_with_child(node_type* node)
+    {
+        if(node->parent == nullptr || node->value.has_value() || node->children.size() != 1)
+            return;
+
+        node_type only_child = std::move(node->children.front());
+
+        node->label.append(only_child.label);
+        node->value    = std::move(only_child.value);
+        node->children = std::move(only_child.children);
+        node->adopt_children();
+    }
+
+    bool erase_node(node_type* node)
+    {
+        if(node == nullptr || !node->value.has_value())
+            return false;
+
+        node->value.reset();
+        --_size;
+
+        node_type* current_node = node;
+        node_type* parent = node->parent;
+
+        while(current_node->children.empty() && !current_node->value.has_value() && parent != nullptr)
+        {
+            parent->children.erase(lower_bound_child(*parent, current_node->label.front()));
+            current_node = parent;
+            parent = current_node->parent;
+        }
+
+        // The last node left on the path might have ended up with a single child
+        merge_with_child(current_node);
+
+        return true;
+    }
+
+public:
+    /********************************* Constructors **********************************/
+    explicit radix_trie(const key_concat&  concat,
+                        const key_compare& compare = key_compare{})
+
+        : _size{0}, _key_concat{concat}, _key_compare{compare}, _root{}
+    {}
+
+    radix_trie(const radix_trie&)     = default;
+    radix_trie(radix_trie&&) noexcept = default;
+    virtual ~radix_trie()             = default;
+
+    /****************************** Assignment operators *****************************/
+
+    radix_trie& operator=(const radix_trie& other) = default;
+    radix_trie& operator=(radix_trie&&) noexcept   = default;
+
+    /*********************************************************************************/
+
+    /****************************** Public Functionality *****************************/
+    bool   empty() const noexcept { return _size == 0;  }
+    size_t size()  const noexcept { return _size;       }
+
+    size_t count(const key_type& key) const
+    {
+        return (find(key) == cend()) ? 0 : 1;
+    }
+
+    /***************************************
+     * Invalidates all previous iterators !!
+    ****************************************/
+    template<typename Key, typename Value>
+    std::pair<iterator,bool> emplace(Key&& key, Value&& value)
+    {
+        const key_type local_key(std::forward<Key>(key));
+        node_type* current_node = &_root;
+
+        for(size_t offset = 0; offset < local_key.size(); )
+        {
+            auto branch = lower_bound_child(*current_node, local_key[offset]);
+
+            // No label starts with this piece, the rest of the key becomes a new leaf
+            if(branch == current_node->children.end() || _key_compare(local_key[offset], branch->label.front()))
+            {
+                current_node = std::addressof(*current_node->children.emplace(branch, local_key.substr(offset), current_node));
+                break;
+            }
+
+            size_t shared = common_prefix(branch->label, local_key, offset);
+
+            // Key diverges inside the label so the edge is split in two
+            if(shared < branch->label.size())
+            {
+                node_type split(branch->label.substr(0, shared), current_node);
+
+                branch->label.erase(0, shared);
+                split.children.push_back(std::move(*branch));
+                *branch = std::move(split);
+            }
+
+            offset      += shared;
+            current_node = std::addressof(*branch);
+        }
+
+        bool emplaced = false;
+        if(!current_node->value.has_value())
+        {
+            current_node->value.emplace(std::forward<Value>(value));
+            emplaced = true;
+            ++_size;
+        }
+
+        return std::make_pair(iterator(current_node, _key_concat),emplaced);
+    }
+
+    /***************************************
+     * Invalidates all iterators !!
+    ****************************************/
+    size_t erase(const key_type& key)
+    {
+        return (erase_node(find_node(key))) ? 1 : 0;
+    }
+
+    /***************************************
+     * Invalidates all iterators !!
+    ****************************************/
+    void erase(iterator pos)
+    {
+        erase_node(pos._pointed_node);
+    }
+
+    iterator find(const key_type& key)
+    {
+        node_type* target = find_node(key);
+        return (target != nullptr && target->value.has_value()) ? iterator(target, _key_concat) : end();
+    }
+
+    const_iterator find(const key_type& key) const
+    {
+        const node_type* target = find_node(key);
+        return (target != nullptr && target->value.has_value()) ? const_iterator(target, _key_concat) : cend();
+    }
+
+    mapped_type& at(const key_type& key)
+    {
+        node_type* target = find_node(key);
+
+        if(target != nullptr && target->value.has_value())
+            return target->value.value();
+        else
+            throw std::out_of_range("radix_trie::at() was invoked with key that is not stored.");
+    }
+
+    const mapped_type& at(const key_type& key) const
+    {
+        const node_type* target = find_node(key);
+
+        if(target != nullptr && target->value.has_value())
+            return target->value.value();
+        else
+            throw std::out_of_range("radix_trie::at() was invoked with key that is not stored.");
+    }
+
+    std::optional<std::reference_wrapper<mapped_type>> operator[](const key_type& key)
+    {
+        node_type* target = find_node(key);
+
+        return (target != nullptr && target->value.has_value())
+                    ? std::optional(std::ref(target->value.value())) : std::nullopt;
+    }
+
+    const std::optional<std::reference_wrapper<const mapped_type>> operator[](const key_type& key) const
+    {
+        const node_type* target = find_node(key);
+
+        return (target != nullptr && target->value.has_value())
+                    ? std::optional(std::cref(target->value.value())) : std::nullopt;
+    }
+
+    // Number of nodes below the root, each of them holding one edge label
+    size_t node_count() const noexcept
+    {
+        size_t nodes = 0;
+        for(std::vector<const node_type*> pending{&_root}; !pending.empty(); )
+        {
+            const node_type* current_node = pending.back();
+            pending.pop_back();
+
+            nodes += current_node->children.size();
+            for(const auto& child : current_node->children)
+                pending.push_back(&child);
+        }
+        return nodes;
+    }
+
+private:
+
+    size_t _size;
+    key_concat  _key_concat;
+    key_compare _key_compare;
+    node_type   _root;
+};
+
+#endif /* RADIX_TRIE__H */
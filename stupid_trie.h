@@ -2,12 +2,16 @@
 #define STUPID_TRIE__H
 
 #include <string>
+#include <string_view>
 #include <utility>
 #include <optional>
 #include <vector>
 #include <algorithm>
 #include <memory>
 #include <stdexcept>
+#include <type_traits>
+
+#include "trie_iterator.h"
 
 template<typename _Tp, 
          typename _Compare = std::less<std::string>>
@@ -17,7 +21,6 @@ class stupid_trie
 
 protected:
     class trie_node;
-    struct node_compare;
 
 public:
     class iterator;
@@ -37,8 +40,9 @@ protected:
     /******************************** Member classes ********************************/
     struct trie_node
     {
-        key_type first;
-        std::reference_wrapper<const key_compare> compare;
+        char piece;         // Last character of the key, siblings only differ in this one
+        size_t key_offset;  // The key is key_length characters at key_offset of the trie's key buffer
+        size_t key_length;
         std::optional<mapped_type> second;
 
         trie_node* parent;
@@ -46,34 +50,18 @@ protected:
 
         /*********************************** Constructors ****************************************************/
         
-        explicit trie_node(const key_compare& key_compare, node_type* parent = nullptr) 
-            : first{}, compare(key_compare), parent(parent)
-        {}
-
-        explicit trie_node(const key_type& key, const key_compare& key_compare, node_type* parent = nullptr)
-            : first(key), compare(key_compare), parent(parent)
-        {}
-
-        explicit trie_node(key_type&& key, const key_compare& key_compare, node_type* parent = nullptr)
-            : first(std::move(key)), compare(key_compare), parent(parent)
+        explicit trie_node(node_type* parent = nullptr) 
+            : piece{}, key_offset(0), key_length(0), parent(parent)
         {}
 
-        explicit trie_node(const key_type& key, const key_compare& key_compare, 
-                           const mapped_type& value, node_type* parent = nullptr)
-
-            : first(key), compare(key_compare), second(value), parent(parent)
-        {}
-
-        explicit trie_node(key_type&& key, const key_compare& key_compare,
-                           mapped_type&& value, node_type* parent = nullptr)
-
-            : first(std::move(key)), compare(key_compare), second(std::move(value)), parent(parent)
+        explicit trie_node(char piece, size_t key_offset, size_t key_length, node_type* parent = nullptr)
+            : piece(piece), key_offset(key_offset), key_length(key_length), parent(parent)
         {}
 
         virtual ~trie_node() = default;
 
         trie_node(const trie_node& other)
-            : first(other.first), compare(other.compare),
+            : piece(other.piece), key_offset(other.key_offset), key_length(other.key_length),
               second(other.second), parent(other.parent) ,children(other.children)
         {
             // Revalidate parent pointers since copy invalidated it
@@ -82,7 +70,7 @@ protected:
         }
 
         trie_node(trie_node&& other) noexcept
-            : first(std::move(other.first)), compare(std::move(other.compare)),
+            : piece(other.piece), key_offset(other.key_offset), key_length(other.key_length),
               second(std::move(other.second)), parent(std::move(other.parent)), 
               children(std::move(other.children))
         {
@@ -94,11 +82,12 @@ protected:
         /************************************ Assignment ****************************************/
         trie_node& operator=(const trie_node& other)
         {
-            this->first    = other.first;
-            this->compare  = other.compare;
-            this->second   = other.second;
-            this->children = other.children;
-            this->parent   = other.parent;
+            this->piece      = other.piece;
+            this->key_offset = other.key_offset;
+            this->key_length = other.key_length;
+            this->second     = other.second;
+            this->children   = other.children;
+            this->parent     = other.parent;
 
             // Revalidate parent pointers since copy invalidated it
             for(auto& child : children)
@@ -109,11 +98,12 @@ protected:
 
         trie_node& operator=(trie_node&& other) noexcept
         {
-            this->first    = std::move(other.first);
-            this->compare  = std::move(other.compare);
-            this->second   = std::move(other.second);
-            this->children = std::move(other.children);
-            this->parent   = std::move(other.parent);
+            this->piece      = other.piece;
+            this->key_offset = other.key_offset;
+            this->key_length = other.key_length;
+            this->second     = std::move(other.second);
+            this->children   = std::move(other.children);
+            this->parent     = std::move(other.parent);
 
             // Revalidate parent pointers since move invalidated it
             for(auto& child : children)
@@ -123,9 +113,14 @@ protected:
         }
 
         /****************************************** Functionality *********************************/
-        bool operator==(const node_type& other) const
+        key_type key(const key_type& keys) const
         {
-            return !compare(first,other.first) && !compare(other.first,first);
+            return keys.substr(key_offset, key_length);
+        }
+
+        std::string_view key_view(const key_type& keys) const noexcept
+        {
+            return std::string_view(keys).substr(key_offset, key_length);
         }
 
         const node_type* next_node() const
@@ -145,11 +140,8 @@ protected:
                         return nullptr;
                 }
 
-                auto next_sibling = ++std::find(current_node->parent->children.begin(), 
-                                                current_node->parent->children.end(), 
-                                                *current_node);
-
-                current_node = std::addressof(*next_sibling);
+                // Siblings are stored next to each other in the parent's children
+                current_node = current_node + 1;
             }
             // There is no next node if root (node with no parent) has no children
             else if(current_node->children.empty() && current_node->parent == nullptr)
@@ -171,24 +163,6 @@ protected:
         }
     };
 
-    /********************************************************
-     * @brief Compares nodes with provided template argument
-     * key_compare in order to maintain class invariance in
-     * children vectors.
-     ********************************************************/
-    struct node_compare
-    {
-        explicit node_compare(const key_compare& compare)
-            : compare(compare){}
-
-        bool operator()(const node_type& lhs, const node_type& rhs) const
-        {
-            return compare(lhs.first,rhs.first);
-        }
-
-        const key_compare& compare;
-    };
-
 public:
     /***************************************** Iterator *******************************************/
     class iterator
@@ -199,9 +173,9 @@ public:
         using iterator_category = std::forward_iterator_tag;
         using difference_type   = std::ptrdiff_t;
         using value_type        = stupid_trie::value_type;
-        using pointer           = std::unique_ptr<value_type>;
+        using pointer           = arrow_proxy<value_type>;
         
-        explicit iterator(node_type* ptr) :  _pointed_node(ptr) {}
+        explicit iterator(node_type* ptr, const key_type& keys) :  _pointed_node(ptr), _keys(&keys) {}
         iterator(const iterator&)            = default;
         iterator(iterator&&) noexcept        = default;
         virtual ~iterator()                  = default;
@@ -211,12 +185,12 @@ public:
 
         value_type operator* () const 
         { 
-            return value_type(_pointed_node->first, _pointed_node->second.value()); 
+            return value_type(_pointed_node->key(*_keys), _pointed_node->second.value()); 
         }
 
         pointer operator->() const 
         { 
-            return std::make_unique<value_type>(_pointed_node->first,_pointed_node->second.value()); 
+            return pointer{value_type(_pointed_node->key(*_keys),_pointed_node->second.value())}; 
         }
         
         iterator& operator++()
@@ -237,6 +211,7 @@ public:
 
     private:
         node_type* _pointed_node;
+        const key_type* _keys;
     };
 
     class const_iterator
@@ -245,12 +220,12 @@ public:
         using iterator_category = std::forward_iterator_tag;
         using difference_type   = std::ptrdiff_t;
         using const_value_type  = std::pair<const key_type, const mapped_type&>;
-        using pointer           = std::unique_ptr<const_value_type>;
+        using pointer           = arrow_proxy<const_value_type>;
 
-        explicit const_iterator(const node_type* ptr) : _pointed_node(ptr) {}
+        explicit const_iterator(const node_type* ptr, const key_type& keys) : _pointed_node(ptr), _keys(&keys) {}
 
         // We are allowing implicit conversion from iterator -> const interator
-        const_iterator(const iterator& it)            : _pointed_node(it._pointed_node) {}
+        const_iterator(const iterator& it)            : _pointed_node(it._pointed_node), _keys(it._keys) {}
 
         virtual ~const_iterator()                        = default;
         const_iterator(const const_iterator&)            = default;
@@ -261,12 +236,12 @@ public:
 
         const_value_type operator* () const 
         { 
-            return value_type(_pointed_node->first, _pointed_node->second.value()); 
+            return const_value_type(_pointed_node->key(*_keys), _pointed_node->second.value()); 
         }
 
-        const pointer operator->() const 
+        pointer operator->() const 
         { 
-            return std::make_unique<const_value_type>(_pointed_node->first,_pointed_node->second.value()); 
+            return pointer{const_value_type(_pointed_node->key(*_keys),_pointed_node->second.value())}; 
         }
         
         const_iterator& operator++()
@@ -287,6 +262,7 @@ public:
 
     private:
         const node_type* _pointed_node;
+        const key_type* _keys;
     };
 
     iterator begin() noexcept
@@ -296,7 +272,7 @@ public:
         while(!current_node->second.has_value())
             current_node = &current_node->children.front();
 
-        return (current_node->second.has_value()) ? iterator(current_node) : end();
+        return (current_node->second.has_value()) ? iterator(current_node, _keys) : end();
     }
 
     const_iterator begin()  const noexcept 
@@ -306,31 +282,101 @@ public:
         while(!current_node->second.has_value())
             current_node = &current_node->children.front();
 
-        return (current_node->second.has_value()) ? iterator(current_node) : end();
+        return (current_node->second.has_value()) ? const_iterator(current_node, _keys) : end();
     }
 
-    iterator       end()          noexcept { return iterator(nullptr);         }
-    const_iterator end()    const noexcept { return const_iterator(nullptr);   }
+    iterator       end()          noexcept { return iterator(nullptr, _keys);         }
+    const_iterator end()    const noexcept { return const_iterator(nullptr, _keys);   }
 
     const_iterator cbegin() const noexcept { return begin();   }
     const_iterator cend()   const noexcept { return end();     }
 
 private:
 
+    // std::less orders keys that only differ in their last character by that character
+    static constexpr bool sorted_by_piece = std::is_same<key_compare, std::less<key_type>>::value;
+
+    static bool piece_less(char lhs, char rhs)
+    {
+        return std::char_traits<char>::lt(lhs, rhs);
+    }
+
+    // Keys handed to comparators that only take key_type, reused by every comparison of one call
+    struct compare_buffers
+    {
+        key_type lhs;
+        key_type rhs;
+    };
+
+    // Comparators taking string_views see the keys where they are, others get them copied into buffers
+    bool key_less(std::string_view lhs, std::string_view rhs, compare_buffers& buffers) const
+    {
+        if constexpr(std::is_invocable_r<bool, const key_compare&, std::string_view, std::string_view>::value)
+            return _key_compare(lhs, rhs);
+        else
+        {
+            buffers.lhs.assign(lhs.data(), lhs.size());
+            buffers.rhs.assign(rhs.data(), rhs.size());
+            return _key_compare(buffers.lhs, buffers.rhs);
+        }
+    }
+
+    // First child of node whose key is not less than key
+    template<typename Node>
+    auto lower_bound_child(Node& node, std::string_view key, compare_buffers& buffers) const
+    {
+        if constexpr(sorted_by_piece)
+            return std::lower_bound(node.children.begin(), node.children.end(), key.back(),
+                                    [](const node_type& child, char p) { return piece_less(child.piece, p); });
+        else
+            return std::lower_bound(node.children.begin(), node.children.end(), key,
+                                    [&](const node_type& child, std::string_view k) { return key_less(child.key_view(_keys), k, buffers); });
+    }
+
+    /********************************************************
+     * @brief Child of node for key, which is the key of node
+     * and one more character. Children are found the way
+     * insert_child orders them, so with comparators other
+     * than std::less the child has to be equivalent to key.
+     ********************************************************/
+    template<typename Node>
+    Node* find_child(Node& node, std::string_view key, compare_buffers& buffers) const
+    {
+        auto branch = lower_bound_child(node, key, buffers);
+
+        if(branch == node.children.end())
+            return nullptr;
+
+        if constexpr(sorted_by_piece)
+            return (branch->piece == key.back()) ? std::addressof(*branch) : nullptr;
+        else
+            return !key_less(key, branch->key_view(_keys), buffers) ? std::addressof(*branch) : nullptr;
+    }
+
+    /********************************************************
+     * @brief Adds the child of node whose key is key_length
+     * characters at key_offset of _keys, at its sorted
+     * position.
+     ********************************************************/
+    node_type* insert_child(node_type& node, size_t key_offset, size_t key_length, compare_buffers& buffers)
+    {
+        std::string_view key = std::string_view(_keys).substr(key_offset, key_length);
+        auto branch = lower_bound_child(node, key, buffers);
+
+        return std::addressof(*node.children.emplace(branch, key.back(), key_offset, key_length, &node));
+    }
+
     const node_type* find_node(const key_type& key) const
     {
         const node_type* current_node = &_root;
-        for(size_t i = 1; i <= key.size(); ++i)
-        {
-            key_type keyPiece = key.substr(0,i);
+        compare_buffers buffers;
 
-            auto branch = std::find_if(current_node->children.begin(), current_node->children.end(), 
-                                       [&](const node_type& child) { return child.first == keyPiece; });
+        for(size_t i = 0; i < key.size(); ++i)
+        {
+            current_node = find_child(*current_node, std::string_view(key).substr(0, i + 1), buffers);
 
-            if(branch == current_node->children.end())
+            if(current_node == nullptr)
                 return nullptr;
-            else
-                current_node = std::addressof(*branch);
         }
         return current_node;
     }
@@ -343,7 +389,7 @@ private:
 public:
     /********************************* Constructors **********************************/
     explicit stupid_trie(const key_compare& compare = key_compare{}) 
-        : _size{0}, _key_compare{compare}, _node_compare{compare}, _root{_key_compare}
+        : _size{0}, _key_compare{compare}, _root{}
     {}
 
     stupid_trie(const stupid_trie&)     = default;
@@ -374,34 +420,26 @@ public:
         key_type local_key(std::forward<Key>(key));
         node_type* current_node = &_root;
 
-        for(size_t i = 1; i <= local_key.size(); ++i)
-        {
-            key_type keyPiece = local_key.substr(0,i);
-
-            // Lookup branch
-            auto branch = std::find_if(current_node->children.begin(), current_node->children.end(), 
-                                       [&](const node_type& child) { return !_key_compare(child.first,keyPiece) &&
-                                                                            !_key_compare(keyPiece,child.first); });
+        compare_buffers buffers;
 
-            // We need new branch if it doesn't exist
-            if(branch == current_node->children.end())
-            {
-                current_node->children.emplace_back(keyPiece, _key_compare ,current_node);
-
-                // Sort children to regain search tree invariant
-                std::sort(current_node->children.begin(),
-                          current_node->children.end(),
-                          _node_compare);
+        // Nodes added for this key share one copy of it in _keys
+        size_t key_offset = key_type::npos;
 
-                // Locate next node since sorting might moved it
-                auto next_node = std::find_if(current_node->children.begin(), current_node->children.end(), 
-                                       [&](const node_type& child) { return !_key_compare(child.first,keyPiece) &&
-                                                                            !_key_compare(keyPiece,child.first); });
+        for(size_t i = 0; i < local_key.size(); ++i)
+        {
+            node_type* branch = find_child(*current_node, std::string_view(local_key).substr(0, i + 1), buffers);
 
-                current_node = std::addressof(*next_node);
+            if(branch == nullptr)
+            {
+                if(key_offset == key_type::npos)
+                {
+                    key_offset = _keys.size();
+                    _keys.append(local_key);
+                }
+                branch = insert_child(*current_node, key_offset, i + 1, buffers);
             }
-            else
-                current_node = std::addressof(*branch);
+
+            current_node = branch;
         }
 
         bool emplaced = false;
@@ -412,19 +450,19 @@ public:
             ++_size;
         }
 
-        return std::make_pair(iterator(current_node),emplaced);
+        return std::make_pair(iterator(current_node, _keys),emplaced);
     }
 
     iterator find(const key_type& key)
     {
         node_type* target = find_node(key);
-        return (target != nullptr && target->second.has_value()) ? iterator(target) : end();
+        return (target != nullptr && target->second.has_value()) ? iterator(target, _keys) : end();
     }
 
     const_iterator find(const key_type& key) const
     {
         const node_type* target = find_node(key);
-        return (target != nullptr && target->second.has_value()) ? const_iterator(target) : cend();
+        return (target != nullptr && target->second.has_value()) ? const_iterator(target, _keys) : cend();
     }
 
     mapped_type& at(const key_type& key)
@@ -467,7 +505,7 @@ private:
 
     size_t _size;    
     key_compare  _key_compare;
-    node_compare _node_compare;
+    key_type     _keys;  // Every key that added nodes, appended once, nodes point into it
     node_type  _root;
 };
 
@@ -0,0 +1,170 @@
+#ifndef TRIE_ARENA__H
+#define TRIE_ARENA__H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/********************************************************
+ * @brief Bump allocator handing out memory from large
+ * chunks. Individual deallocations are ignored, every
+ * chunk is released at once when the arena dies.
+ *
+ * Arenas are reference counted by the allocators bound
+ * to them. The count is not atomic: like the tries using
+ * it, an arena must not be shared between threads.
+ ********************************************************/
+class trie_arena
+{
+public:
+    explicit trie_arena(size_t chunk_size = 64 * 1024)
+        : _chunk_size(chunk_size), _cursor(nullptr), _space(0), _references(0)
+    {}
+
+    trie_arena(const trie_arena&)            = delete;
+    trie_arena& operator=(const trie_arena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment)
+    {
+        if(std::align(alignment, bytes, _cursor, _space) == nullptr)
+        {
+            size_t chunk_size = std::max(_chunk_size, bytes + alignment);
+
+            _chunks.emplace_back(new unsigned char[chunk_size]);
+            _cursor = _chunks.back().get();
+            _space  = chunk_size;
+            _reserved += chunk_size;
+
+            std::align(alignment, bytes, _cursor, _space);
+        }
+
+        void* allocated = _cursor;
+        _cursor = static_cast<unsigned char*>(_cursor) + bytes;
+        _space -= bytes;
+
+        return allocated;
+    }
+
+    // Bytes taken from the heap so far
+    size_t reserved() const noexcept { return _reserved; }
+
+private:
+    template<typename> friend class arena_allocator;
+
+    void acquire() noexcept { ++_references; }
+
+    // Deletes arena with its last reference
+    static void release(trie_arena* arena) noexcept
+    {
+        size_t references = --arena->_references;
+
+        if(references == 0)
+            delete arena;
+    }
+
+    std::vector<std::unique_ptr<unsigned char[]>> _chunks;
+    size_t _chunk_size;
+    size_t _reserved = 0;
+    void*  _cursor;
+    size_t _space;
+    size_t _references;
+};
+
+/********************************************************
+ * @brief Allocator template that can be passed to trie
+ * as its _Alloc parameter.
+ *
+ * A default constructed arena_allocator is not bound to
+ * any arena and simply forwards to the heap, so key_type
+ * strings built with it cost nothing extra. A trie asks
+ * its node allocator for select_on_trie_construction()
+ * though, which binds it to a new arena owned by the
+ * nodes of that trie. Node storage is then freed in bulk
+ * when the trie is destroyed or cleared. Copies of a trie
+ * share the arena of the original.
+ ********************************************************/
+template<typename T>
+class arena_allocator
+{
+public:
+    using value_type = T;
+
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+    using is_always_equal                        = std::false_type;
+
+    arena_allocator() noexcept
+        : _arena(nullptr) {}
+
+    explicit arena_allocator(trie_arena* arena) noexcept
+        : _arena(arena)
+    {
+        if(_arena != nullptr)
+            _arena->acquire();
+    }
+
+    arena_allocator(const arena_allocator& other) noexcept
+        : arena_allocator(other._arena) {}
+
+    template<typename U>
+    arena_allocator(const arena_allocator<U>& other) noexcept
+        : arena_allocator(other._arena) {}
+
+    ~arena_allocator()
+    {
+        if(_arena != nullptr)
+            trie_arena::release(_arena);
+    }
+
+    arena_allocator& operator=(arena_allocator other) noexcept
+    {
+        std::swap(_arena, other._arena);
+        return *this;
+    }
+
+    // Trades arenas without touching their reference counts
+    friend void swap(arena_allocator& lhs, arena_allocator& rhs) noexcept
+    {
+        std::swap(lhs._arena, rhs._arena);
+    }
+
+    T* allocate(size_t n)
+    {
+        if(_arena == nullptr)
+            return std::allocator<T>{}.allocate(n);
+
+        return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept
+    {
+        // Arena memory is only given back when the arena itself dies
+        if(_arena == nullptr)
+            std::allocator<T>{}.deallocate(ptr, n);
+    }
+
+    arena_allocator select_on_trie_construction() const
+    {
+        return arena_allocator(new trie_arena());
+    }
+
+    const trie_arena* arena() const noexcept { return _arena; }
+
+    template<typename U>
+    friend bool operator==(const arena_allocator& lhs, const arena_allocator<U>& rhs) noexcept { return lhs.arena() == rhs.arena(); }
+
+    template<typename U>
+    friend bool operator!=(const arena_allocator& lhs, const arena_allocator<U>& rhs) noexcept { return !(lhs == rhs); }
+
+private:
+    template<typename> friend class arena_allocator;
+
+    trie_arena* _arena;
+};
+
+#endif /* TRIE_ARENA__H */
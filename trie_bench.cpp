@@ -0,0 +1,935 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "stupid_trie.h"
+#include "generic_trie.h"
+#include "frozen_trie.h"
+#include "radix_trie.h"
+#include "adaptive_trie.h"
+#include "concurrent_trie.h"
+#include "persistent_trie.h"
+#include "compact_trie.h"
+#include "trie_arena.h"
+
+/** Micro benchmarks for the generic trie
+ *  -------------------------------------
+
+Build with optimizations, e.g.
+
+    g++ -std=c++17 -O2 -pthread trie_bench.cpp -o trie_bench
+
+Numbers are wall clock nanoseconds per operation, averaged over every key of
+the workload. They are only meant to be compared against each other on the
+same machine.
+
+*/
+
+using u32_concat_t = std::u32string& (*)(std::u32string&, char32_t);
+
+static std::u32string& u32_concat(std::u32string& Seq, char32_t C) {
+  Seq.push_back(C);
+  return Seq;
+}
+
+using u32_trie = trie<char32_t, int, u32_concat_t>;
+
+// Every heap allocation made by the benchmarks is counted here, along with
+// the bytes currently allocated, from whichever thread. Blocks carry their
+// size in front of them.
+static std::atomic<size_t> Allocations{0};
+static std::atomic<size_t> LiveBytes{0};
+
+static constexpr size_t BlockHeader = alignof(std::max_align_t);
+
+void* operator new(size_t Size) {
+  ++Allocations;
+  if (auto* Block = static_cast<unsigned char*>(std::malloc(Size + BlockHeader))) {
+    *reinterpret_cast<size_t*>(Block) = Size;
+    LiveBytes += Size;
+    return Block + BlockHeader;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* Ptr) noexcept {
+  if (Ptr == nullptr)
+    return;
+  auto* Block = static_cast<unsigned char*>(Ptr) - BlockHeader;
+  LiveBytes -= *reinterpret_cast<size_t*>(Block);
+  std::free(Block);
+}
+
+void operator delete(void* Ptr, size_t) noexcept { operator delete(Ptr); }
+
+template <typename Fn>
+static double nanoseconds_per_op(size_t Ops, Fn&& F) {
+  auto Start = std::chrono::steady_clock::now();
+  F();
+  auto Stop = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(Stop - Start).count() / Ops;
+}
+
+// Keeps the optimizer from throwing away the benchmarked work.
+static volatile size_t Sink;
+
+// Every key is two code points long, so both the root and every node on the
+// first level have exactly Fanout children.
+static std::vector<std::u32string> fanout_keys(size_t Fanout) {
+  std::vector<std::u32string> Keys;
+  for (size_t I = 0; I < Fanout; ++I)
+    for (size_t J = 0; J < Fanout; ++J)
+      Keys.push_back({static_cast<char32_t>(0x4E00 + I),
+                      static_cast<char32_t>(0x4E00 + J)});
+
+  std::shuffle(Keys.begin(), Keys.end(), std::mt19937{42});
+  return Keys;
+}
+
+// Same size as a trie<char32_t, int, ...> node, so that the sibling scan
+// strides over memory the way the trie does.
+struct sibling {
+  char32_t key_piece;
+  char padding[60];
+};
+
+static void child_search(size_t Fanout) {
+  std::vector<sibling> Siblings(Fanout);
+  for (size_t I = 0; I < Fanout; ++I)
+    Siblings[I].key_piece = static_cast<char32_t>(0x4E00 + I);
+
+  std::vector<char32_t> Probes;
+  for (size_t I = 0; I < 1000000; ++I)
+    Probes.push_back(static_cast<char32_t>(0x4E00 + (I * 7919) % Fanout));
+
+  double Linear = nanoseconds_per_op(Probes.size(), [&] {
+    size_t Found = 0;
+    for (char32_t Probe : Probes)
+      Found += std::find_if(Siblings.begin(), Siblings.end(),
+                            [&](const sibling& S) { return S.key_piece == Probe; })
+               - Siblings.begin();
+    Sink = Found;
+  });
+
+  double Binary = nanoseconds_per_op(Probes.size(), [&] {
+    size_t Found = 0;
+    for (char32_t Probe : Probes)
+      Found += std::lower_bound(Siblings.begin(), Siblings.end(), Probe,
+                                [](const sibling& S, char32_t P) { return S.key_piece < P; })
+               - Siblings.begin();
+    Sink = Found;
+  });
+
+  std::printf("child search  fanout %5zu: find_if %7.2f ns, lower_bound %7.2f ns\n",
+              Fanout, Linear, Binary);
+}
+
+static void trie_find(size_t Fanout) {
+  std::vector<std::u32string> Keys = fanout_keys(Fanout);
+  u32_trie Trie{u32_concat};
+  double Emplace = nanoseconds_per_op(Keys.size(), [&] {
+    for (const auto& Key : Keys)
+      Trie.emplace(Key, 1);
+  });
+
+  double Find = nanoseconds_per_op(Keys.size(), [&] {
+    size_t Found = 0;
+    for (const auto& Key : Keys)
+      Found += Trie.count(Key);
+    Sink = Found;
+  });
+
+  double Scan = nanoseconds_per_op(Trie.size(), [&] {
+    size_t Values = 0;
+    for (auto It = Trie.cbegin(); It != Trie.cend(); ++It)
+      Values += It->second;
+    Sink = Values;
+  });
+
+  std::printf("trie          fanout %5zu: emplace %7.2f ns, count %7.2f ns, scan %7.2f ns over %zu keys\n",
+              Fanout, Emplace, Find, Scan, Keys.size());
+}
+
+using char_concat_t = std::string& (*)(std::string&, char);
+
+static std::string& char_concat(std::string& Seq, char C) {
+  Seq.push_back(C);
+  return Seq;
+}
+
+using char_trie = trie<char, int, char_concat_t>;
+
+// Random lowercase words, shaped roughly like a dictionary.
+static std::vector<std::string> dictionary_keys(size_t Count) {
+  std::mt19937 Rng{1337};
+  std::uniform_int_distribution<int> Length(3, 12);
+  std::uniform_int_distribution<int> Letter('a', 'z');
+
+  std::vector<std::string> Keys(Count);
+  for (auto& Key : Keys) {
+    Key.resize(Length(Rng));
+    for (char& C : Key)
+      C = static_cast<char>(Letter(Rng));
+  }
+  return Keys;
+}
+
+static void frozen_find(size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  char_trie Trie{char_concat};
+  for (const auto& Key : Keys)
+    Trie.emplace(Key, 1);
+
+  frozen_trie<char, int, char_concat_t> Frozen{Trie};
+
+  double TrieFind = nanoseconds_per_op(Keys.size(), [&] {
+    size_t Found = 0;
+    for (const auto& Key : Keys)
+      Found += Trie.count(Key);
+    Sink = Found;
+  });
+
+  double FrozenFind = nanoseconds_per_op(Keys.size(), [&] {
+    size_t Found = 0;
+    for (const auto& Key : Keys)
+      Found += Frozen.count(Key);
+    Sink = Found;
+  });
+
+  std::printf("frozen_trie   %zu keys: trie count %7.2f ns, frozen count %7.2f ns, "
+              "frozen %5.2f bytes/key\n",
+              Keys.size(), TrieFind, FrozenFind,
+              static_cast<double>(Frozen.memory_usage()) / Frozen.size());
+}
+
+// Cold start: building the trie from its keys against opening a saved frozen
+// trie, then serving the first lookups from the mapping.
+static void frozen_open(size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  const char* Path = "trie_bench_frozen.bin";
+
+  double Build = nanoseconds_per_op(1, [&] {
+    char_trie Trie{char_concat};
+    for (const auto& Key : Keys)
+      Trie.emplace(Key, 1);
+    frozen_trie<char, int, char_concat_t> Frozen{Trie};
+
+    std::ofstream Out(Path, std::ios::binary);
+    Frozen.save(Out);
+    Sink = Frozen.size();
+  });
+
+  size_t Found = 0;
+  double Open = nanoseconds_per_op(1, [&] {
+    auto Mapped = frozen_trie<char, int, char_concat_t>::open(Path, char_concat);
+    for (size_t I = 0; I < 1000; ++I)
+      Found += Mapped.count(Keys[I]);
+    Sink = Found;
+  });
+  std::remove(Path);
+
+  std::printf("frozen open   %zu keys: build and save %8.2f ms, open and 1000 counts %6.3f ms\n",
+              Keys.size(), Build / 1e6, Open / 1e6);
+}
+
+// Restoring a checkpoint: emplacing every key again against reading the
+// serialized trie back.
+static void stream_load(size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  char_trie Trie{char_concat};
+  for (const auto& Key : Keys)
+    Trie.emplace(Key, 1);
+
+  std::stringstream Stream;
+  Trie.serialize(Stream);
+  std::string Serialized = Stream.str();
+
+  std::optional<char_trie> Rebuilt{char_concat};
+  double Emplace = nanoseconds_per_op(Trie.size(), [&] {
+    for (auto It = Trie.cbegin(); It != Trie.cend(); ++It)
+      Rebuilt->emplace(It.key(), It->second);
+  });
+  Rebuilt.reset();
+
+  std::istringstream In(Serialized);
+  std::optional<char_trie> Loaded{char_concat};
+  size_t AllocationsBefore = Allocations;
+  double Load = nanoseconds_per_op(Trie.size(), [&] { Loaded->deserialize(In); });
+
+  std::printf("stream load   %zu keys: emplace %7.2f ns, deserialize %7.2f ns per key, "
+              "%zu allocations, %5.2f bytes/key\n",
+              Trie.size(), Emplace, Load, Allocations - AllocationsBefore,
+              static_cast<double>(Serialized.size()) / Trie.size());
+}
+
+// Loading an already sorted key dump: emplacing every key against the sorted
+// bulk load.
+static void sorted_load(size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  std::sort(Keys.begin(), Keys.end());
+
+  std::vector<std::pair<std::string, int>> Elements;
+  for (const auto& Key : Keys)
+    Elements.emplace_back(Key, 1);
+
+  std::optional<char_trie> Emplaced{char_concat};
+  size_t AllocationsBefore = Allocations;
+  double Emplace = nanoseconds_per_op(Elements.size(), [&] {
+    for (const auto& [Key, Value] : Elements)
+      Emplaced->emplace(Key, Value);
+  });
+  size_t EmplaceAllocations = Allocations - AllocationsBefore;
+  Emplaced.reset();
+
+  std::optional<char_trie> Loaded{char_concat};
+  AllocationsBefore = Allocations;
+  double Load = nanoseconds_per_op(Elements.size(), [&] {
+    Loaded->assign_sorted(Elements.begin(), Elements.end());
+  });
+
+  std::printf("sorted load   %zu keys: emplace %7.2f ns, %zu allocations, "
+              "assign_sorted %7.2f ns, %zu allocations\n",
+              Elements.size(), Emplace, EmplaceAllocations, Load,
+              Allocations - AllocationsBefore);
+}
+
+// Building a dictionary from unsorted keys: emplacing them one by one against
+// emplace_parallel on every hardware thread.
+static void parallel_build(size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  std::vector<std::pair<std::string, int>> Elements;
+  for (const auto& Key : Keys)
+    Elements.emplace_back(Key, 1);
+
+  double Serial = nanoseconds_per_op(Elements.size(), [&] {
+    char_trie Trie{char_concat};
+    for (const auto& [Key, Value] : Elements)
+      Trie.emplace(Key, Value);
+    Sink = Trie.size();
+  });
+
+  size_t Threads = std::max(1u, std::thread::hardware_concurrency());
+  double Parallel = nanoseconds_per_op(Elements.size(), [&] {
+    char_trie Trie{char_concat};
+    Trie.emplace_parallel(Elements.begin(), Elements.end(), Threads);
+    Sink = Trie.size();
+  });
+
+  std::printf("parallel build %zu keys: emplace %7.2f ns, emplace_parallel on %zu threads %7.2f ns\n",
+              Elements.size(), Serial, Threads, Parallel);
+}
+
+// URL paths share long prefixes and end in long unique tails.
+static std::vector<std::string> url_keys(size_t Count) {
+  static const char* const Hosts[] = {"https://api.example.com", "https://static.example.com",
+                                      "https://example.org"};
+  static const char* const Routes[] = {"/v1/users/", "/v1/orders/", "/v2/users/",
+                                       "/assets/images/", "/assets/scripts/"};
+  std::mt19937 Rng{7};
+
+  std::vector<std::string> Keys(Count);
+  for (auto& Key : Keys)
+    Key = std::string(Hosts[Rng() % 3]) + Routes[Rng() % 5] + std::to_string(Rng()) +
+          "/details";
+  return Keys;
+}
+
+// Nodes of a one piece per node trie: the distinct non empty prefixes.
+static size_t prefix_count(std::vector<std::string> Keys) {
+  std::sort(Keys.begin(), Keys.end());
+  Keys.erase(std::unique(Keys.begin(), Keys.end()), Keys.end());
+
+  size_t Prefixes = 0;
+  for (size_t I = 0; I < Keys.size(); ++I) {
+    size_t Shared = 0;
+    if (I > 0)
+      while (Shared < Keys[I].size() && Shared < Keys[I - 1].size() &&
+             Keys[I][Shared] == Keys[I - 1][Shared])
+        ++Shared;
+    Prefixes += Keys[I].size() - Shared;
+  }
+  return Prefixes;
+}
+
+static void radix_find(size_t Count) {
+  std::vector<std::string> Keys = url_keys(Count);
+  char_trie Trie{char_concat};
+  radix_trie<char, int, char_concat_t> Radix{char_concat};
+
+  double TrieEmplace = nanoseconds_per_op(Keys.size(), [&] {
+    for (const auto& Key : Keys)
+      Trie.emplace(Key, 1);
+  });
+
+  double RadixEmplace = nanoseconds_per_op(Keys.size(), [&] {
+    for (const auto& Key : Keys)
+      Radix.emplace(Key, 1);
+  });
+
+  double TrieFind = nanoseconds_per_op(Keys.size(), [&] {
+    size_t Found = 0;
+    for (const auto& Key : Keys)
+      Found += Trie.count(Key);
+    Sink = Found;
+  });
+
+  double RadixFind = nanoseconds_per_op(Keys.size(), [&] {
+    size_t Found = 0;
+    for (const auto& Key : Keys)
+      Found += Radix.count(Key);
+    Sink = Found;
+  });
+
+  std::printf("radix_trie    %zu urls: trie %zu nodes, emplace %7.2f ns, count %7.2f ns\n"
+              "                          radix %zu nodes, emplace %7.2f ns, count %7.2f ns\n",
+              Keys.size(), prefix_count(Keys), TrieEmplace, TrieFind,
+              Radix.node_count(), RadixEmplace, RadixFind);
+}
+
+using arena_string = std::basic_string<char, std::char_traits<char>, arena_allocator<char>>;
+using arena_concat_t = arena_string& (*)(arena_string&, char);
+
+static arena_string& arena_concat(arena_string& Seq, char C) {
+  Seq.push_back(C);
+  return Seq;
+}
+
+using arena_trie = trie<char, int, arena_concat_t, std::less, std::basic_string,
+                        std::char_traits, arena_allocator>;
+
+template <typename Trie, typename Concat>
+static void build_and_destroy(const char* Name, Concat Concat_, size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  std::vector<typename Trie::key_type> TrieKeys(Keys.begin(), Keys.end());
+
+  std::optional<Trie> Built{Concat_};
+  double Emplace = nanoseconds_per_op(TrieKeys.size(), [&] {
+    for (const auto& Key : TrieKeys)
+      Built->emplace(Key, 1);
+  });
+
+  double Destroy = nanoseconds_per_op(TrieKeys.size(), [&] { Built.reset(); });
+
+  std::printf("%-14s %zu keys: emplace %7.2f ns, destroy %7.2f ns per key\n",
+              Name, TrieKeys.size(), Emplace, Destroy);
+}
+
+// Same ordering as std::less, but keeps the trie on its lower_bound search.
+template <typename T> struct plain_less : std::less<T> {};
+
+// Two character keys over Fanout distinct bytes, found through the packed
+// child keys and through lower_bound over the children.
+static void char_child_search(size_t Fanout) {
+  std::vector<std::string> Keys;
+  for (size_t I = 0; I < Fanout; ++I)
+    for (size_t J = 0; J < Fanout; ++J)
+      Keys.push_back({static_cast<char>(I), static_cast<char>(J)});
+  std::shuffle(Keys.begin(), Keys.end(), std::mt19937{42});
+
+  char_trie Packed{char_concat};
+  trie<char, int, char_concat_t, plain_less> Plain{char_concat};
+  for (const auto& Key : Keys) {
+    Packed.emplace(Key, 1);
+    Plain.emplace(Key, 1);
+  }
+
+  auto Count = [&](const auto& Trie) {
+    return nanoseconds_per_op(Keys.size() * 20, [&] {
+      size_t Found = 0;
+      for (int Round = 0; Round < 20; ++Round)
+        for (const auto& Key : Keys)
+          Found += Trie.count(Key);
+      Sink = Found;
+    });
+  };
+  double LowerBound = Count(Plain);
+  double Simd = Count(Packed);
+
+  std::printf("char trie     fanout %5zu: lower_bound %7.2f ns, packed keys %7.2f ns\n",
+              Fanout, LowerBound, Simd);
+}
+
+// Heap bytes held by the tries after building them, and lookup latency.
+static void adaptive_find(size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  std::vector<std::string> Probes = Keys;
+  std::shuffle(Probes.begin(), Probes.end(), std::mt19937{7});
+
+  auto Measure = [&](auto& Trie, const char* Name) {
+    size_t BytesBefore = LiveBytes;
+    double Emplace = nanoseconds_per_op(Keys.size(), [&] {
+      for (const auto& Key : Keys)
+        Trie.emplace(Key, 1);
+    });
+    size_t Bytes = LiveBytes - BytesBefore;
+
+    double Find = nanoseconds_per_op(Probes.size(), [&] {
+      size_t Found = 0;
+      for (const auto& Probe : Probes)
+        Found += Trie.count(Probe);
+      Sink = Found;
+    });
+
+    std::printf("%-13s %zu keys: %6.1f MB, emplace %7.2f ns, count %7.2f ns\n",
+                Name, Trie.size(), Bytes / 1e6, Emplace, Find);
+  };
+
+  {
+    char_trie Trie{char_concat};
+    Measure(Trie, "trie");
+  }
+  {
+    adaptive_trie<char, int, char_concat_t> Adaptive{char_concat};
+    Measure(Adaptive, "adaptive_trie");
+  }
+}
+
+// Lookups per second over all reader threads while one writer keeps
+// emplacing and erasing keys, for a trie behind a shared_mutex and for
+// concurrent_trie.
+template <typename Read, typename Write>
+static double reads_per_second(size_t Readers, Read&& ReadOne, Write&& WriteOne) {
+  std::atomic<bool> Done{false};
+  std::atomic<size_t> Reads{0};
+
+  std::vector<std::thread> Threads;
+  for (size_t R = 0; R < Readers; ++R)
+    Threads.emplace_back([&, R] {
+      size_t Local = 0;
+      for (size_t I = R; !Done.load(std::memory_order_relaxed); I += 7919)
+        Local += ReadOne(I);
+      Reads += Local;
+    });
+
+  auto Start = std::chrono::steady_clock::now();
+  for (size_t I = 0; std::chrono::steady_clock::now() - Start < std::chrono::milliseconds(500); ++I)
+    WriteOne(I);
+  Done = true;
+
+  for (auto& Thread : Threads)
+    Thread.join();
+  return Reads / 0.5;
+}
+
+static void concurrent_find(size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  size_t Readers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+  char_trie Trie{char_concat};
+  std::shared_mutex Lock;
+  concurrent_trie<char, int, char_concat_t> Concurrent{char_concat};
+  for (const auto& Key : Keys) {
+    Trie.emplace(Key, 1);
+    Concurrent.emplace(Key, 1);
+  }
+
+  double Locked = reads_per_second(Readers,
+      [&](size_t I) {
+        std::shared_lock<std::shared_mutex> Guard(Lock);
+        return Trie.count(Keys[I % Keys.size()]);
+      },
+      [&](size_t I) {
+        std::unique_lock<std::shared_mutex> Guard(Lock);
+        if (I % 2 == 0)
+          Trie.erase(Keys[I / 2 % Keys.size()]);
+        else
+          Trie.emplace(Keys[I / 2 % Keys.size()], 1);
+      });
+
+  double LockFree = reads_per_second(Readers,
+      [&](size_t I) { return Concurrent.count(Keys[I % Keys.size()]); },
+      [&](size_t I) {
+        if (I % 2 == 0)
+          Concurrent.erase(Keys[I / 2 % Keys.size()]);
+        else
+          Concurrent.emplace(Keys[I / 2 % Keys.size()], 1);
+      });
+
+  std::printf("concurrent    %zu readers, 1 writer: shared_mutex %6.2f M reads/s, concurrent_trie %6.2f M reads/s\n",
+              Readers, Locked / 1e6, LockFree / 1e6);
+}
+
+// Taking a snapshot and changing one key in it: a trie copy against a new
+// persistent_trie version sharing every untouched subtree.
+static void snapshot_update(size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  char_trie Trie{char_concat};
+  persistent_trie<char, int, char_concat_t> Persistent{char_concat};
+  for (const auto& Key : Keys) {
+    Trie.emplace(Key, 1);
+    Persistent = Persistent.emplace(Key, 1);
+  }
+
+  const size_t Snapshots = 20;
+  std::vector<char_trie> TrieSnapshots;
+  std::vector<decltype(Persistent)> Versions;
+  TrieSnapshots.reserve(Snapshots);
+  Versions.reserve(Snapshots);
+
+  size_t BytesBefore = LiveBytes;
+  double Copy = nanoseconds_per_op(Snapshots, [&] {
+    for (size_t I = 0; I < Snapshots; ++I) {
+      TrieSnapshots.push_back(Trie);
+      TrieSnapshots.back().erase(Keys[I]);
+    }
+  });
+  size_t CopyBytes = (LiveBytes - BytesBefore) / Snapshots;
+
+  BytesBefore = LiveBytes;
+  double Version = nanoseconds_per_op(Snapshots, [&] {
+    for (size_t I = 0; I < Snapshots; ++I)
+      Versions.push_back(Persistent.erase(Keys[I]));
+  });
+  size_t VersionBytes = (LiveBytes - BytesBefore) / Snapshots;
+
+  std::printf("snapshot      %zu keys: trie copy %10.0f ns %9zu bytes, persistent version %7.0f ns %6zu bytes\n",
+              Trie.size(), Copy, CopyBytes, Version, VersionBytes);
+}
+
+// Random lookups in a trie much larger than the last level cache.
+static void batch_find(size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  char_trie Trie{char_concat};
+  for (const auto& Key : Keys)
+    Trie.emplace(Key, 1);
+
+  std::vector<std::string> Probes = Keys;
+  std::shuffle(Probes.begin(), Probes.end(), std::mt19937{7});
+
+  double Loop = nanoseconds_per_op(Probes.size(), [&] {
+    size_t Found = 0;
+    for (const auto& Probe : Probes)
+      Found += Trie.find(Probe) != Trie.end();
+    Sink = Found;
+  });
+
+  std::vector<char_trie::iterator> Results;
+  Results.reserve(256);
+  double Batched = nanoseconds_per_op(Probes.size(), [&] {
+    size_t Found = 0;
+    for (size_t I = 0; I < Probes.size(); I += 256) {
+      Results.clear();
+      Trie.find_batch(Probes.begin() + I, Probes.begin() + std::min(I + 256, Probes.size()),
+                      std::back_inserter(Results));
+      for (const auto& It : Results)
+        Found += It != Trie.end();
+    }
+    Sink = Found;
+  });
+
+  std::printf("batch find    %zu keys: find loop %7.2f ns, find_batch %7.2f ns\n",
+              Trie.size(), Loop, Batched);
+}
+
+// Routes are prefixes of the requested URLs, deeper routes are more specific.
+static void longest_prefix(size_t Count) {
+  std::vector<std::string> Urls = url_keys(Count);
+  char_trie Routes{char_concat};
+  for (size_t I = 0; I < Urls.size(); I += 4) {
+    Routes.emplace(Urls[I].substr(0, Urls[I].find('/', 8)), 1);
+    Routes.emplace(Urls[I].substr(0, Urls[I].rfind('/')), 2);
+  }
+
+  double RepeatedFind = nanoseconds_per_op(Urls.size(), [&] {
+    size_t Matched = 0;
+    for (const auto& Url : Urls)
+      for (size_t Length = Url.size() + 1; Length-- > 0;) {
+        auto It = Routes.find(Url.substr(0, Length));
+        if (It != Routes.end()) {
+          Matched += It->second;
+          break;
+        }
+      }
+    Sink = Matched;
+  });
+
+  double SingleDescent = nanoseconds_per_op(Urls.size(), [&] {
+    size_t Matched = 0;
+    for (const auto& Url : Urls) {
+      auto It = Routes.longest_prefix_match(Url);
+      if (It != Routes.end())
+        Matched += It->second;
+    }
+    Sink = Matched;
+  });
+
+  std::printf("longest match %zu urls: repeated find %8.2f ns, longest_prefix_match %7.2f ns\n",
+              Urls.size(), RepeatedFind, SingleDescent);
+}
+
+static void full_scan(size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  char_trie Trie{char_concat};
+  for (const auto& Key : Keys)
+    Trie.emplace(Key, 1);
+
+  size_t AllocationsBefore = Allocations;
+  double Scan = nanoseconds_per_op(Trie.size(), [&] {
+    size_t KeyBytes = 0;
+    for (auto It = Trie.cbegin(); It != Trie.cend(); ++It)
+      KeyBytes += It.key().size() + It.value();
+    Sink = KeyBytes;
+  });
+
+  std::printf("full scan     %zu keys: %7.2f ns per element, %zu allocations\n",
+              Trie.size(), Scan, Allocations - AllocationsBefore);
+}
+
+// Summing every value: a range-for over the iterators against
+// parallel_reduce on every hardware thread.
+static void parallel_sum(size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  char_trie Trie{char_concat};
+  for (const auto& Key : Keys)
+    Trie.emplace(Key, 1);
+
+  double Serial = nanoseconds_per_op(Trie.size(), [&] {
+    size_t Sum = 0;
+    for (auto It = Trie.cbegin(); It != Trie.cend(); ++It)
+      Sum += It->second;
+    Sink = Sum;
+  });
+
+  size_t Threads = std::max(1u, std::thread::hardware_concurrency());
+  double Parallel = nanoseconds_per_op(Trie.size(), [&] {
+    Sink = Trie.parallel_reduce(size_t{0}, [](const std::string&, int Value) { return size_t(Value); },
+                                std::plus<size_t>{}, char_trie::traversal_order::any, Threads);
+  });
+
+  std::printf("parallel sum  %zu keys: range-for %7.2f ns, parallel_reduce on %zu threads %7.2f ns\n",
+              Trie.size(), Serial, Threads, Parallel);
+}
+
+// Page 37 of the completions of a two letter prefix: stepping to it from the
+// start of prefix_range against rank and select.
+static void paginate(size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  char_trie Trie{char_concat};
+  for (const auto& Key : Keys)
+    Trie.emplace(Key, 1);
+
+  const size_t PageSize = 10, Page = 37;
+  std::vector<std::string> Prefixes;
+  for (char First = 'a'; First <= 'z'; ++First)
+    for (char Second = 'a'; Second <= 'z'; ++Second)
+      Prefixes.push_back({First, Second});
+
+  double Stepping = nanoseconds_per_op(Prefixes.size(), [&] {
+    size_t Found = 0;
+    for (const auto& Prefix : Prefixes) {
+      auto [It, Last] = Trie.prefix_range(Prefix);
+      for (size_t I = 0; I < Page * PageSize && It != Last; ++I)
+        ++It;
+      Found += It != Last;
+    }
+    Sink = Found;
+  });
+
+  double Selecting = nanoseconds_per_op(Prefixes.size(), [&] {
+    size_t Found = 0;
+    for (const auto& Prefix : Prefixes)
+      Found += Page * PageSize < Trie.count_prefix(Prefix) &&
+               Trie.select(Trie.rank(Prefix) + Page * PageSize) != Trie.end();
+    Sink = Found;
+  });
+
+  std::printf("paginate      %zu keys: page %zu by stepping %9.2f ns, by rank and select %7.2f ns\n",
+              Trie.size(), Page, Stepping, Selecting);
+}
+
+// The string keyed trie the legacy services use, on URL keys long enough that
+// per level prefix copies would dominate.
+static void stupid_find(size_t Count) {
+  std::vector<std::string> Keys = url_keys(Count);
+  stupid_trie<int> Trie;
+  double Emplace = nanoseconds_per_op(Keys.size(), [&] {
+    for (const auto& Key : Keys)
+      Trie.emplace(Key, 1);
+  });
+
+  size_t AllocationsBefore = Allocations;
+  double Find = nanoseconds_per_op(Keys.size(), [&] {
+    size_t Found = 0;
+    for (const auto& Key : Keys)
+      Found += Trie.count(Key);
+    Sink = Found;
+  });
+
+  std::printf("stupid_trie   %zu keys: emplace %8.2f ns, count %8.2f ns, %zu allocations\n",
+              Keys.size(), Emplace, Find, Allocations - AllocationsBefore);
+}
+
+// Looking up keys held as string_views, the way request handlers see them:
+// converting each one to the key type against passing it as it is.
+static void view_find(size_t Count) {
+  std::vector<std::string> Keys = url_keys(Count);
+  char_trie Trie{char_concat};
+  for (const auto& Key : Keys)
+    Trie.emplace(Key, 1);
+
+  std::vector<std::string_view> Views(Keys.begin(), Keys.end());
+
+  size_t AllocationsBefore = Allocations;
+  double Converted = nanoseconds_per_op(Views.size(), [&] {
+    size_t Found = 0;
+    for (std::string_view View : Views)
+      Found += Trie.count(std::string(View));
+    Sink = Found;
+  });
+  size_t ConvertedAllocations = Allocations - AllocationsBefore;
+
+  AllocationsBefore = Allocations;
+  double Direct = nanoseconds_per_op(Views.size(), [&] {
+    size_t Found = 0;
+    for (std::string_view View : Views)
+      Found += Trie.count(View);
+    Sink = Found;
+  });
+
+  std::printf("view lookup   %zu keys: via std::string %7.2f ns, %zu allocations, "
+              "string_view %7.2f ns, %zu allocations\n",
+              Views.size(), Converted, ConvertedAllocations, Direct,
+              Allocations - AllocationsBefore);
+}
+
+// Bytes per key of the generic trie against the one with 32-bit node indices,
+// and what the smaller nodes do to lookups.
+static void compact_nodes(size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  char_trie Trie{char_concat};
+  compact_trie<char, int, char_concat_t> Compact{char_concat};
+  for (const auto& Key : Keys) {
+    Trie.emplace(Key, 1);
+    Compact.emplace(Key, 1);
+  }
+
+  double TrieFind = nanoseconds_per_op(Keys.size(), [&] {
+    size_t Found = 0;
+    for (const auto& Key : Keys)
+      Found += Trie.count(Key);
+    Sink = Found;
+  });
+
+  double CompactFind = nanoseconds_per_op(Keys.size(), [&] {
+    size_t Found = 0;
+    for (const auto& Key : Keys)
+      Found += Compact.count(Key);
+    Sink = Found;
+  });
+
+  std::printf("compact_trie  %zu keys: trie %6.2f bytes/key count %7.2f ns, "
+              "compact %6.2f bytes/key count %7.2f ns\n",
+              Trie.size(), static_cast<double>(Trie.memory_usage()) / Trie.size(),
+              TrieFind, static_cast<double>(Compact.memory_usage()) / Compact.size(),
+              CompactFind);
+}
+
+// Capacity left behind by erasing most of a dictionary, before and after
+// shrink_to_fit, and what a stats() pass costs.
+static void shrink_after_erase(size_t Count) {
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  char_trie Trie{char_concat};
+  for (const auto& Key : Keys)
+    Trie.emplace(Key, 1);
+  for (size_t I = 0; I < Keys.size(); I += 4)
+    for (size_t J = I; J < std::min(I + 3, Keys.size()); ++J)
+      Trie.erase(Keys[J]);
+
+  char_trie::trie_stats Stats;
+  double Scan = nanoseconds_per_op(1, [&] { Stats = Trie.stats(); });
+  size_t Before = Trie.memory_usage();
+
+  double Shrink = nanoseconds_per_op(1, [&] { Trie.shrink_to_fit(); });
+
+  std::printf("shrink_to_fit %zu keys: stats %6.2f ms, %5.1f%% slack, %10zu bytes before, "
+              "%10zu after in %6.2f ms\n",
+              Trie.size(), Scan / 1e6, 100.0 * Stats.slack_bytes / Before, Before,
+              Trie.memory_usage(), Shrink / 1e6);
+}
+
+// What counting costs on lookups, and what a lookup does on average.
+static void counted_find(size_t Count) {
+  using counted_trie = trie<char, int, char_concat_t, std::less, std::basic_string,
+                            std::char_traits, std::allocator, thread_trie_counters>;
+
+  std::vector<std::string> Keys = dictionary_keys(Count);
+  char_trie Trie{char_concat};
+  counted_trie Counted{char_concat};
+  for (const auto& Key : Keys) {
+    Trie.emplace(Key, 1);
+    Counted.emplace(Key, 1);
+  }
+
+  double Plain = nanoseconds_per_op(Keys.size(), [&] {
+    size_t Found = 0;
+    for (const auto& Key : Keys)
+      Found += Trie.count(Key);
+    Sink = Found;
+  });
+
+  counted_trie::reset_counters();
+  double WithCounters = nanoseconds_per_op(Keys.size(), [&] {
+    size_t Found = 0;
+    for (const auto& Key : Keys)
+      Found += Counted.count(Key);
+    Sink = Found;
+  });
+  trie_counter_values Counters = counted_trie::counters();
+
+  std::printf("counters      %zu keys: count %7.2f ns, counted %7.2f ns, "
+              "%5.2f nodes and %5.2f comparisons per lookup\n",
+              Keys.size(), Plain, WithCounters,
+              static_cast<double>(Counters.nodes_visited) / Keys.size(),
+              static_cast<double>(Counters.child_comparisons) / Keys.size());
+}
+
+int main() {
+  for (size_t Fanout : {4, 16, 64, 256, 1024})
+    child_search(Fanout);
+
+  for (size_t Fanout : {4, 16, 64, 256, 1024})
+    trie_find(Fanout);
+
+  for (size_t Fanout : {4, 16, 64, 256})
+    char_child_search(Fanout);
+
+  frozen_find(1000000);
+  frozen_open(1000000);
+  stream_load(1000000);
+  sorted_load(1000000);
+  parallel_build(2000000);
+  radix_find(200000);
+  adaptive_find(2000000);
+  concurrent_find(100000);
+  snapshot_update(100000);
+  batch_find(4000000);
+  longest_prefix(200000);
+  full_scan(1000000);
+  parallel_sum(1000000);
+  paginate(1000000);
+  stupid_find(100000);
+  view_find(200000);
+  compact_nodes(1000000);
+  shrink_after_erase(1000000);
+  counted_find(1000000);
+
+  build_and_destroy<char_trie>("std::allocator", char_concat, 1000000);
+  build_and_destroy<arena_trie>("arena", arena_concat, 1000000);
+
+  return 0;
+}
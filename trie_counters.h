@@ -0,0 +1,77 @@
+#ifndef TRIE_COUNTERS__H
+#define TRIE_COUNTERS__H
+
+#include <cstddef>
+
+/********************************************************
+ * @brief Instrumentation policies of the generic trie.
+ *
+ * The trie reports its hot path work to the static
+ * functions of its _Counters parameter. no_trie_counters
+ * is the default, its functions are empty and inline, so
+ * they compile to nothing and the trie stays as it was.
+ *
+ * thread_trie_counters keeps one set of counters per
+ * thread, shared by every trie using it, so counting
+ * takes no atomics and no locks. A thread reads and
+ * resets only its own counters.
+ ********************************************************/
+struct trie_counter_values
+{
+    size_t nodes_visited     = 0;  // Nodes whose children were searched
+    size_t child_comparisons = 0;  // key_compare calls made searching children, SIMD searches make none
+    size_t child_insertions  = 0;  // Children emplace added at their sorted position
+    size_t nodes_freed       = 0;  // Nodes erase pruned
+    size_t key_bytes_traced  = 0;  // Bytes of keys traced back from nodes
+};
+
+struct no_trie_counters
+{
+    static constexpr bool enabled = false;
+
+    static void visit_node()               noexcept {}
+    static void compare_child()            noexcept {}
+    static void insert_child()             noexcept {}
+    static void free_node()                noexcept {}
+    static void trace_key(size_t)          noexcept {}
+
+    // Nothing is counted, so the counters always read zero
+    static constexpr trie_counter_values read()  noexcept { return trie_counter_values{}; }
+    static void                          reset() noexcept {}
+    static void add(const trie_counter_values&)  noexcept {}
+};
+
+struct thread_trie_counters
+{
+    static constexpr bool enabled = true;
+
+    static void visit_node()               noexcept { ++local().nodes_visited;     }
+    static void compare_child()            noexcept { ++local().child_comparisons; }
+    static void insert_child()             noexcept { ++local().child_insertions;  }
+    static void free_node()                noexcept { ++local().nodes_freed;       }
+    static void trace_key(size_t bytes)    noexcept { local().key_bytes_traced += bytes; }
+
+    // Counters of the calling thread
+    static trie_counter_values read()  noexcept { return local(); }
+    static void                reset() noexcept { local() = trie_counter_values{}; }
+
+    // Takes over counts made on another thread
+    static void add(const trie_counter_values& values) noexcept
+    {
+        trie_counter_values& counters = local();
+        counters.nodes_visited     += values.nodes_visited;
+        counters.child_comparisons += values.child_comparisons;
+        counters.child_insertions  += values.child_insertions;
+        counters.nodes_freed       += values.nodes_freed;
+        counters.key_bytes_traced  += values.key_bytes_traced;
+    }
+
+private:
+    static trie_counter_values& local() noexcept
+    {
+        thread_local trie_counter_values values;
+        return values;
+    }
+};
+
+#endif /* TRIE_COUNTERS__H */
@@ -0,0 +1,20 @@
+#ifndef TRIE_ITERATOR__H
+#define TRIE_ITERATOR__H
+
+#include <memory>
+
+/********************************************************
+ * @brief Returned by the operator-> of the trie iterators.
+ * Their elements are pairs built on the fly, so the proxy
+ * holds one by value and member access goes through it,
+ * without putting a value_type on the heap.
+ ********************************************************/
+template<typename Pair>
+struct arrow_proxy
+{
+    Pair pair;
+
+    const Pair* operator->() const noexcept { return std::addressof(pair); }
+};
+
+#endif /* TRIE_ITERATOR__H */
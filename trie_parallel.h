@@ -0,0 +1,140 @@
+#ifndef TRIE_PARALLEL__H
+#define TRIE_PARALLEL__H
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+/********************************************************
+ * @brief Runs a batch of independent tasks on a few
+ * threads, the calling one included.
+ *
+ * Tasks are numbered from 0 and dealt out round-robin to
+ * one queue per thread in that order, so callers number
+ * their biggest tasks first. A thread takes tasks from
+ * the front of its own queue and, once that is empty,
+ * steals from the back of the others, which is where the
+ * smallest tasks wait.
+ *
+ * The first exception thrown by a task is rethrown by
+ * run() after every thread has stopped, the tasks not
+ * yet started are dropped.
+ *
+ * When a thread cannot be started run() goes on with the
+ * threads it has, which steal the queues of the missing
+ * ones.
+ ********************************************************/
+class work_stealing_pool
+{
+public:
+    explicit work_stealing_pool(size_t thread_count = std::thread::hardware_concurrency())
+        : _thread_count(std::max<size_t>(thread_count, 1))
+    {}
+
+    size_t thread_count() const noexcept { return _thread_count; }
+
+    template<typename Task>
+    void run(size_t task_count, Task&& task) const
+    {
+        size_t worker_count = std::min(_thread_count, task_count);
+        if(worker_count <= 1)
+        {
+            for(size_t index = 0; index < task_count; ++index)
+                task(index);
+            return;
+        }
+
+        std::vector<queue> queues(worker_count);
+        for(size_t index = 0; index < task_count; ++index)
+            queues[index % worker_count].tasks.push_back(index);
+
+        std::mutex         failure_mutex;
+        std::exception_ptr failure;
+
+        auto work = [&](size_t worker)
+        {
+            try
+            {
+                for(size_t index; take(queues, worker, index);)
+                    task(index);
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(failure_mutex);
+                if(!failure)
+                    failure = std::current_exception();
+
+                for(auto& victim : queues)
+                {
+                    std::lock_guard<std::mutex> victim_lock(victim.mutex);
+                    victim.tasks.clear();
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(worker_count - 1);
+        for(size_t worker = 1; worker < worker_count; ++worker)
+        {
+            try
+            {
+                threads.emplace_back(work, worker);
+            }
+            catch(const std::system_error&)
+            {
+                break;
+            }
+        }
+
+        work(0);
+        for(auto& thread : threads)
+            thread.join();
+
+        if(failure)
+            std::rethrow_exception(failure);
+    }
+
+private:
+    struct queue
+    {
+        std::mutex         mutex;
+        std::deque<size_t> tasks;
+    };
+
+    // Next task of worker, its own first and then one stolen from the others
+    static bool take(std::vector<queue>& queues, size_t worker, size_t& index)
+    {
+        {
+            std::lock_guard<std::mutex> lock(queues[worker].mutex);
+            if(!queues[worker].tasks.empty())
+            {
+                index = queues[worker].tasks.front();
+                queues[worker].tasks.pop_front();
+                return true;
+            }
+        }
+
+        for(size_t offset = 1; offset < queues.size(); ++offset)
+        {
+            queue& victim = queues[(worker + offset) % queues.size()];
+
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.tasks.empty())
+            {
+                index = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t _thread_count;
+};
+
+#endif /* TRIE_PARALLEL__H */
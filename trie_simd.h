@@ -0,0 +1,167 @@
+#ifndef TRIE_SIMD__H
+#define TRIE_SIMD__H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <immintrin.h>
+#define TRIE_SIMD_SSE2 1
+#endif
+
+/********************************************************
+ * @brief True when children with key_piece can be found
+ * by comparing raw bytes: 1 or 2 byte integral pieces
+ * ordered by std::less, for which equivalence under the
+ * comparator is plain equality.
+ ********************************************************/
+template<typename _Key_Piece, typename _Compare>
+struct is_simd_key_piece
+    : std::integral_constant<bool, std::is_integral<_Key_Piece>::value &&
+                                   !std::is_same<_Key_Piece, bool>::value &&
+                                   sizeof(_Key_Piece) <= 2 &&
+                                   std::is_same<_Compare, std::less<_Key_Piece>>::value>
+{};
+
+/********************************************************
+ * @brief Copy of the key pieces of a node's children,
+ * packed next to each other so that they can be compared
+ * 16 or 32 bytes at a time.
+ *
+ * AVX2 compares two blocks per step when the build
+ * enables it, builds without SSE2 scan the array with
+ * std::find.
+ *
+ * The array is a mirror of the children vector and does
+ * not know its own length: every operation is passed the
+ * current number of children. Storage is padded to whole
+ * 16 byte blocks, so the kernels never read past it and
+ * only have to ignore matches in the padding.
+ *
+ * The primary template is empty and is what every other
+ * key piece type gets.
+ ********************************************************/
+template<typename _Key_Piece, typename _Allocator, bool _Enabled>
+class child_key_array
+{
+public:
+    child_key_array() = default;
+    explicit child_key_array(const _Allocator&) {}
+
+    void reserve_child(size_t) {}
+    void reserve_keys(size_t) {}
+    void insert_child(size_t, size_t, const _Key_Piece&) noexcept {}
+    void erase_child(size_t, size_t) noexcept {}
+    void shrink_keys() {}
+
+    size_t keys_memory_usage() const noexcept { return 0; }
+};
+
+template<typename _Key_Piece, typename _Allocator>
+class child_key_array<_Key_Piece, _Allocator, true>
+{
+public:
+    child_key_array() = default;
+    explicit child_key_array(const _Allocator& allocator) : _keys(allocator) {}
+
+    // Makes room for one more key, so that insert_child can't throw afterwards
+    void reserve_child(size_t count)
+    {
+        if(count == _keys.size())
+            _keys.resize(_keys.size() + block_size);
+    }
+
+    // Room for count keys in one allocation, reserve_child then stays within it
+    void reserve_keys(size_t count)
+    {
+        _keys.reserve((count + block_size - 1) / block_size * block_size);
+    }
+
+    void insert_child(size_t index, size_t count, const _Key_Piece& key_piece) noexcept
+    {
+        std::copy_backward(_keys.begin() + index, _keys.begin() + count, _keys.begin() + count + 1);
+        _keys[index] = key_piece;
+    }
+
+    void erase_child(size_t index, size_t count) noexcept
+    {
+        std::copy(_keys.begin() + index + 1, _keys.begin() + count, _keys.begin() + index);
+
+        if(count - 1 <= _keys.size() - block_size)
+            _keys.resize(_keys.size() - block_size);
+    }
+
+    // Drops the capacity erase_child left behind, whole blocks stay
+    void shrink_keys() { _keys.shrink_to_fit(); }
+
+    const _Key_Piece* child_keys() const noexcept { return _keys.data(); }
+
+    // Heap bytes of the packed keys, padding and spare capacity included
+    size_t keys_memory_usage() const noexcept { return _keys.capacity() * sizeof(_Key_Piece); }
+
+    // Index of the child with key_piece, count if there's none
+    size_t find_child(const _Key_Piece& key_piece, size_t count) const noexcept
+    {
+#if defined(TRIE_SIMD_SSE2)
+        const _Key_Piece* keys = _keys.data();
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        for(; i < count && i + 2 * block_size <= _keys.size(); i += 2 * block_size)
+        {
+            unsigned match = wide_block_match(keys + i, key_piece);
+
+            if(match != 0)
+                return std::min(i + __builtin_ctz(match) / sizeof(_Key_Piece), count);
+        }
+#endif
+        for(; i < count; i += block_size)
+        {
+            unsigned match = block_match(keys + i, key_piece);
+
+            // Keys are unique, so the first match is the only real one
+            if(match != 0)
+                return std::min(i + __builtin_ctz(match) / sizeof(_Key_Piece), count);
+        }
+        return count;
+#else
+        return std::find(_keys.begin(), _keys.begin() + count, key_piece) - _keys.begin();
+#endif
+    }
+
+private:
+    static constexpr size_t block_size = 16 / sizeof(_Key_Piece);
+
+#if defined(TRIE_SIMD_SSE2)
+    // One bit per byte of the block that is part of a key equal to key_piece
+    static unsigned block_match(const _Key_Piece* block, const _Key_Piece& key_piece) noexcept
+    {
+        __m128i keys = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+
+        if(sizeof(_Key_Piece) == 1)
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(keys, _mm_set1_epi8(static_cast<char>(key_piece))));
+        else
+            return _mm_movemask_epi8(_mm_cmpeq_epi16(keys, _mm_set1_epi16(static_cast<short>(key_piece))));
+    }
+#endif
+
+#if defined(__AVX2__)
+    // Same as block_match, over two blocks
+    static unsigned wide_block_match(const _Key_Piece* block, const _Key_Piece& key_piece) noexcept
+    {
+        __m256i keys = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+
+        if(sizeof(_Key_Piece) == 1)
+            return _mm256_movemask_epi8(_mm256_cmpeq_epi8(keys, _mm256_set1_epi8(static_cast<char>(key_piece))));
+        else
+            return _mm256_movemask_epi8(_mm256_cmpeq_epi16(keys, _mm256_set1_epi16(static_cast<short>(key_piece))));
+    }
+#endif
+
+    std::vector<_Key_Piece, _Allocator> _keys;
+};
+
+#endif /* TRIE_SIMD__H */
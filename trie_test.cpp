@@ -1,16 +1,32 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <new>
 #include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
 #include "stupid_trie.h"
 #include "generic_trie.h"
+#include "frozen_trie.h"
+#include "radix_trie.h"
+#include "adaptive_trie.h"
+#include "concurrent_trie.h"
+#include "persistent_trie.h"
+#include "compact_trie.h"
+#include "trie_arena.h"
 
 /** http://enwp.org/Trie
  *  --------------------
@@ -153,6 +169,33 @@ x
   Expected = "(abel->16),(gs->-24),(gsd->43),(whispy->69),(xazax->1337)";
   assert(Result == Expected);
 
+  // Other comparators order siblings by their whole keys, prefixes still come
+  // before the keys they start.
+  stupid_trie<int, std::greater<std::string>> Reversed;
+  for (const char* Key : {"gs", "whispy", "gsd", "gsa", "abel", "whisk"})
+    Reversed.emplace(Key, 0);
+
+  OS.str("");
+  for (const auto& Elem : Reversed)
+    OS << Elem.first << ',';
+  assert(OS.str() == "whispy,whisk,gs,gsd,gsa,abel," && Reversed.count("whis") == 0);
+
+  // Children equivalent under the comparator are the same child.
+  struct Caseless {
+    bool operator()(const std::string& L, const std::string& R) const {
+      return std::lexicographical_compare(
+          L.begin(), L.end(), R.begin(), R.end(), [](char A, char B) {
+            return std::tolower(static_cast<unsigned char>(A)) <
+                   std::tolower(static_cast<unsigned char>(B));
+          });
+    }
+  };
+  stupid_trie<int, Caseless> Folded;
+  Folded.emplace("Ab", 1);
+  assert(!Folded.emplace("ab", 2).second && Folded.size() == 1);
+  assert(Folded.find("AB") != Folded.end() && Folded.find("AB")->second == 1 &&
+         Folded.begin()->first == "Ab");
+
   return 1;
 }
 
@@ -200,6 +243,33 @@ int stupid_noncopyable() {
   return 1;
 }
 
+// Length prefixed strings for trie serialization.
+struct string_codec {
+  void encode(std::ostream& Out, const std::string& Value) const {
+    size_t Length = Value.size();
+    Out.write(reinterpret_cast<const char*>(&Length), sizeof(Length));
+    Out.write(Value.data(), Length);
+  }
+
+  std::string decode(std::istream& In) const {
+    size_t Length = 0;
+    In.read(reinterpret_cast<char*>(&Length), sizeof(Length));
+    std::string Value(In ? Length : 0, '\0');
+    if (!In.read(Value.data(), Value.size()))
+      throw std::runtime_error("string_codec could not read a string.");
+    return Value;
+  }
+};
+
+// Whether Key can be looked up in Trie at all.
+template <typename Trie, typename Key, typename = void>
+struct can_count : std::false_type {};
+
+template <typename Trie, typename Key>
+struct can_count<Trie, Key,
+                 std::void_t<decltype(std::declval<const Trie&>().count(std::declval<const Key&>()))>>
+    : std::true_type {};
+
 int generic() {
   // Alright, let's go all in this time. The problem with the conventional trie
   // is that std::strings might be expensive to store. There is also no need to
@@ -388,6 +458,19 @@ x
   Expected = "(xazax->1337),(whispy->69),(gsd->43),(gs->-24),(abel->16)";
   assert(Result == Expected);
 
+  // Iterators keep the key of the pointed element up to date while moving
+  auto KeyIt = GTI.begin();
+  assert(KeyIt.key() == "abel" && (++KeyIt).key() == "gs" &&
+         (++KeyIt).key() == "gsd" && (--KeyIt).key() == "gs");
+
+  // Copies trace their own key again when it is read
+  auto KeyCopy = KeyIt++;
+  decltype(GTI)::const_iterator KeyConst = KeyCopy;
+  assert(KeyCopy.key() == "gs" && KeyIt->first == "gsd" &&
+         KeyConst->first == "gs" && (++KeyConst)->first == "gsd" &&
+         std::make_reverse_iterator(KeyIt)->first == "gs" &&
+         KeyCopy.value() == -24 && KeyConst.value() == 43);
+
   // Find test
   auto findWhispy = GTI.find("whispy");
   assert(findWhispy != GTI.end() && findWhispy->first == "whispy" && findWhispy->second == 69);
@@ -395,15 +478,1024 @@ x
   auto findGregorics = GTI.find("Gregorics");
   assert(findGregorics == GTI.end() && "No Grego Gang");
 
+  // Prefix test
+  OS.str("");
+  auto [PrefixBegin, PrefixEnd] = GTI.prefix_range("g");
+  for (auto It = PrefixBegin; It != PrefixEnd; ++It) {
+    OS << '(' << It->first << "->" << It->second << "),";
+  }
+  Result = OS.str();
+  Result.pop_back();
+  Expected = "(gs->-24),(gsd->43)";
+  assert(Result == Expected);
+
+  auto NoPrefix = cGTI.prefix_range("whispyy");
+  assert(NoPrefix.first == cGTI.end() && NoPrefix.second == cGTI.end());
+
+  int PrefixSum = 0;
+  cGTI.for_each_prefix("", [&](const int& Value) { PrefixSum += Value; });
+  assert(PrefixSum == 16 - 24 + 43 + 69 + 1337);
+  GTI.for_each_prefix("gsd", [](int& Value) { ++Value; });
+  assert(GTI.at("gsd") == 44 && GTI.at("gs") == -24);
+
+  // Longest prefix match test
+  assert(GTI.longest_prefix_match("gsdx")->first == "gsd" &&
+         GTI.longest_prefix_match("gsa")->first == "gs" &&
+         cGTI.longest_prefix_match("whispy")->second == 69);
+  assert(GTI.longest_prefix_match("g") == GTI.end() &&
+         cGTI.longest_prefix_match("") == cGTI.end());
+
+  // Batch find test, longer than one batch so that lanes get refilled
+  std::vector<std::string> BatchKeys;
+  for(const char* Key : {"gs", "g", "gsd", "whisp", "", "gsdx", "whispy", "xazax"})
+    for(int I = 0; I < 3; ++I)
+      BatchKeys.push_back(Key);
+
+  std::vector<decltype(GTI)::const_iterator> BatchFound;
+  cGTI.find_batch(BatchKeys.begin(), BatchKeys.end(), std::back_inserter(BatchFound));
+  assert(BatchFound.size() == BatchKeys.size());
+  for(size_t I = 0; I < BatchKeys.size(); ++I)
+    assert(BatchFound[I] == cGTI.find(BatchKeys[I]));
+
+  // Keys of other ranges are looked up in place
+  std::vector<std::string_view> BatchViews(BatchKeys.begin(), BatchKeys.end());
+  std::vector<const char*> BatchPointers;
+  for(const std::string& Key : BatchKeys)
+    BatchPointers.push_back(Key.c_str());
+
+  std::vector<decltype(GTI)::const_iterator> ViewsFound, PointersFound;
+  cGTI.find_batch(BatchViews.begin(), BatchViews.end(), std::back_inserter(ViewsFound));
+  cGTI.find_batch(BatchPointers.begin(), BatchPointers.end(), std::back_inserter(PointersFound));
+  assert(ViewsFound == BatchFound && PointersFound == BatchFound);
+
+  // Serialization test, a round trip keeps every element and its order
+  std::stringstream Stream;
+  cGTI.serialize(Stream);
+  decltype(GTI) Loaded{CharToStringConcat};
+  Loaded.emplace("stale", 0);
+  Loaded.deserialize(Stream);
+  assert(Loaded.size() == GTI.size() && Loaded.count("stale") == 0 &&
+         std::equal(Loaded.begin(), Loaded.end(), cGTI.begin(),
+                    [](const auto& L, const auto& R) {
+                      return L.first == R.first && L.second == R.second;
+                    }));
+
+  // Values that are not trivially copyable go through a codec
+  trie<char, std::string, decltype(CharToStringConcat)> Names{CharToStringConcat};
+  Names.emplace("", "root");
+  Names.emplace("gs", "Gergely");
+  Names.emplace("gsd", "");
+  Stream.str("");
+  Names.serialize(Stream, string_codec{});
+  decltype(Names) LoadedNames{CharToStringConcat};
+  LoadedNames.deserialize(Stream, string_codec{});
+  assert(LoadedNames.size() == 3 && LoadedNames.at("") == "root" &&
+         LoadedNames.at("gs") == "Gergely" && LoadedNames.at("gsd").empty());
+
+  // Malformed input is rejected and leaves the trie alone
+  Stream.str("TRIESTR1 but truncated");
+  try {
+    LoadedNames.deserialize(Stream, string_codec{});
+    assert(false && "Should have been unreachable.");
+  } catch (const std::runtime_error&) {
+  }
+  assert(LoadedNames.size() == 3);
+
+  // So is a child count no node could have, without reserving for it
+  decltype(GTI) EmptyTrie{CharToStringConcat};
+  Stream.str("");
+  EmptyTrie.serialize(Stream);
+  std::string Huge = Stream.str();
+  Huge.pop_back();
+  Huge += "\xfe\xff\xff\xff\xff\xff\xff\x7f";
+  for (const std::string& Corrupt : {Huge, Huge.substr(0, Huge.size() - 7) + '\x02'}) {
+    Stream.str(Corrupt);
+    try {
+      Loaded.deserialize(Stream);
+      assert(false && "Should have been unreachable.");
+    } catch (const std::runtime_error&) {
+    }
+  }
+  assert(Loaded.size() == GTI.size());
+
+  // Sorted bulk load test, builds the same trie as emplacing each element
+  std::vector<std::pair<std::string, int>> Sorted;
+  for (auto It = cGTI.begin(); It != cGTI.end(); ++It)
+    Sorted.emplace_back(It->first, It->second);
+  Sorted.insert(Sorted.begin() + 2, Sorted[1]);
+
+  decltype(GTI) Bulk{CharToStringConcat, Sorted.begin(), Sorted.end()};
+  assert(Bulk.size() == GTI.size() &&
+         std::equal(Bulk.begin(), Bulk.end(), cGTI.begin(),
+                    [](const auto& L, const auto& R) {
+                      return L.first == R.first && L.second == R.second;
+                    }));
+
+  std::swap(Sorted.front(), Sorted.back());
+  try {
+    Bulk.assign_sorted(Sorted.begin(), Sorted.end());
+    assert(false && "Should have been unreachable.");
+  } catch (const std::invalid_argument&) {
+  }
+  assert(Bulk.size() == GTI.size() && Bulk.at("gsd") == GTI.at("gsd"));
+
+  // Parallel build test, ends up like emplacing the pairs one by one
+  std::vector<std::pair<std::string, int>> Unsorted;
+  for (int I = 0; I < 2000; ++I)
+    Unsorted.emplace_back(std::to_string(I * 7919 % 1000), I);
+  Unsorted.emplace_back("", 1);
+  Unsorted.emplace_back("", 2);
+
+  decltype(GTI) Serial{CharToStringConcat}, Parallel{CharToStringConcat};
+  Serial.emplace("42", -1);
+  Parallel.emplace("42", -1);
+  for (const auto& [Key, Value] : Unsorted)
+    Serial.emplace(Key, Value);
+  Parallel.emplace_parallel(Unsorted.begin(), Unsorted.end(), 4);
+  assert(Parallel.size() == 1001 && Parallel.at("42") == -1 &&
+         std::equal(Parallel.begin(), Parallel.end(), Serial.begin(),
+                    [](const auto& L, const auto& R) {
+                      return L.first == R.first && L.second == R.second;
+                    }));
+
+  // A value failing to copy leaves no empty branches behind
+  struct Fragile {
+    int Value;
+    explicit Fragile(int V) : Value(V) {}
+    Fragile(Fragile&&) = default;
+    Fragile& operator=(Fragile&&) = default;
+    Fragile& operator=(const Fragile&) = default;
+    Fragile(const Fragile& Other) : Value(Other.Value) {
+      if (Value < 0)
+        throw std::runtime_error("Fragile could not be copied.");
+    }
+  };
+  std::vector<std::pair<std::string, Fragile>> Failing;
+  for (const auto& [Key, Value] : {std::pair<const char*, int>{"ab", 1}, {"cd", -1}, {"ce", 2}, {"xy", 3}})
+    Failing.emplace_back(Key, Fragile(Value));
+  trie<char, Fragile, decltype(CharToStringConcat)> Partial{CharToStringConcat};
+  try {
+    Partial.emplace_parallel(Failing.begin(), Failing.end(), 4);
+    assert(false && "Should have been unreachable.");
+  } catch (const std::runtime_error&) {
+  }
+  assert(Partial.count("cd") == 0 && Partial.count("ce") == 0 &&
+         static_cast<std::size_t>(std::distance(Partial.begin(), Partial.end())) == Partial.size() &&
+         Partial.stats().node_count == 1 + 2 * Partial.size());
+
+  // Parallel traversal test, on more threads than there are subtrees
+  std::atomic<int> ParallelSum{0};
+  Parallel.parallel_for_each([&](const std::string& Key, int& Value) {
+    if (Key == "42")
+      Value = 42;
+    ParallelSum += Value;
+  }, 4);
+  int SerialSum = 0;
+  for (const auto& [Key, Value] : Parallel)
+    SerialSum += Value;
+  assert(Parallel.at("42") == 42 && ParallelSum == SerialSum);
+
+  std::string SerialKeys;
+  for (auto It = Parallel.cbegin(); It != Parallel.cend(); ++It)
+    SerialKeys += It->first + ",";
+  const auto& cParallel = Parallel;
+  std::string ParallelKeys = cParallel.parallel_reduce(
+      std::string{}, [](const std::string& Key, int) { return Key + ","; },
+      [](std::string L, const std::string& R) { return L + R; },
+      decltype(Parallel)::traversal_order::key, 3);
+  assert(ParallelKeys == SerialKeys);
+  assert(cParallel.parallel_reduce(0, [](const std::string&, int V) { return V; },
+                                   std::plus<int>{}) == SerialSum);
+  assert(Bulk.parallel_reduce(7, [](const std::string&, int V) { return V; },
+                              std::plus<int>{}) == 7 + 16 - 24 + 44 + 69 + 1337);
+
+  // Heterogeneous lookup test, any range of pieces is a key without making a string
+  std::string_view Whispy = "whispy and more";
+  const char* GsdPointer = "gsd";
+  const char GsArray[] = {'g', 's'};
+  std::vector<char> GsdVector{'g', 's', 'd'};
+  assert(cGTI.find(Whispy.substr(0, 6))->second == 69 && cGTI.at(GsdPointer) == 44 &&
+         cGTI.count(GsArray) == 1 && GTI[GsdVector].value().get() == 44 &&
+         cGTI.count(Whispy) == 0 && cGTI.rank(std::string_view("gsa")) == 2 &&
+         cGTI.count_prefix(std::string_view("g")) == 2);
+  assert(Loaded.emplace(std::string_view("gsdx"), 5).second && Loaded.at("gsdx") == 5 &&
+         Loaded.erase(std::string_view("gsdx")) == 1 && Loaded.count("gsdx") == 0);
+
+  // Ranges of wider pieces would be narrowed at every comparison, they don't compile
+  static_assert(can_count<decltype(GTI), std::string_view>::value &&
+                can_count<decltype(GTI), const char*>::value);
+  static_assert(!can_count<decltype(GTI), std::vector<int>>::value &&
+                !can_count<decltype(GTI), std::u32string>::value &&
+                !can_count<decltype(GTI), std::wstring>::value);
+
+  // Rank and select test, the k-th element in key order has k keys before it
+  const auto& CheckOrderStatistics = [](const auto& T) {
+    size_t K = 0;
+    for (auto It = T.begin(); It != T.end(); ++It, ++K) {
+      assert(T.select(K) == It && T.rank(It->first) == K);
+      auto Range = T.prefix_range(It->first);
+      assert(T.count_prefix(It->first) ==
+             static_cast<size_t>(std::distance(Range.first, Range.second)));
+    }
+    assert(K == T.size() && T.select(K) == T.end());
+  };
+  CheckOrderStatistics(cGTI);
+  CheckOrderStatistics(Loaded);
+  CheckOrderStatistics(Bulk);
+  CheckOrderStatistics(cParallel);
+  assert(cGTI.rank("gsa") == 2 && cGTI.rank("gsda") == 3 && cGTI.rank("zzz") == cGTI.size() &&
+         cGTI.count_prefix("g") == 2 && cGTI.count_prefix("") == cGTI.size() &&
+         cGTI.count_prefix("whispyy") == 0);
+
   // Erase test
   GTI.erase("gs");
   assert(GTI.count("gs") == 0 && GTI.count("gsd") == 1);
 
   auto GT = GTI.emplace("Gregorics", 420).first;
   assert(GTI.count("Gregorics") == 1);
+  CheckOrderStatistics(cGTI);
 
   GTI.erase(GT);
   assert(GTI.count("Gregorics") == 0);
+  CheckOrderStatistics(cGTI);
+
+  // Structure statistics, and the capacity erase leaves behind
+  trie<char, int, decltype(CharToStringConcat)> Shape{CharToStringConcat};
+  for (const char* Key : {"gsd", "gs", "abel", "whispy", "xazax"})
+    Shape.emplace(Key, 1);
+
+  auto Stats = Shape.stats();
+  assert(Stats.node_count == 19 && Stats.valued_node_count == 5);
+  assert((Stats.depth_histogram == std::vector<std::size_t>{1, 4, 4, 4, 3, 2, 1}));
+  assert((Stats.fanout_histogram == std::vector<std::size_t>{4, 14, 0, 0, 1}));
+  assert(Stats.average_key_length == 4.0 && Stats.value_bytes == 5 * sizeof(int));
+  assert(sizeof(Shape) + Stats.node_bytes + Stats.slack_bytes == Shape.memory_usage());
+
+  Shape.erase("whispy");
+  Shape.erase("xazax");
+  assert(Shape.stats().slack_bytes > 0);
+
+  std::size_t Before = Shape.memory_usage();
+  Shape.shrink_to_fit();
+  Stats = Shape.stats();
+  assert(Stats.slack_bytes == 0 && Stats.node_count == 8 && Shape.memory_usage() < Before);
+
+  // Moved nodes still know their parents
+  Shape.erase("gsd");
+  std::ostringstream Shrunk;
+  for (const auto& Elem : Shape)
+    Shrunk << Elem.first << ',';
+  assert(Shrunk.str() == "abel,gs," && Shape.stats().node_count == 7);
+
+  return 1;
+}
+
+int generic_frozen() {
+  const auto& CharToStringConcat = [](std::string& Seq, char C)
+      -> std::string& {
+    Seq.push_back(C);
+    return Seq;
+  };
+
+  trie<char, int, decltype(CharToStringConcat)> GTI{CharToStringConcat};
+  GTI.emplace("gsd", 42);
+  GTI.emplace("whispy", 69);
+  GTI.emplace("xazax", 1337);
+  GTI.emplace("gs", -24);
+  GTI.emplace("abel", 16);
+
+  // Routing tables are built once with the generic trie and then frozen.
+  const frozen_trie<char, int, decltype(CharToStringConcat)> FTI{GTI};
+
+  assert(!FTI.empty() && FTI.size() == 5);
+  assert(FTI.count("gsd") == 1 && FTI.count("gs") == 1 && FTI.count("g") == 0 &&
+         FTI.count("whispyy") == 0 && FTI.count("") == 0);
+  assert(FTI.at("xazax") == 1337 && FTI["abel"].value() == 16);
+  assert(!FTI["foo"].has_value());
+
+  try {
+    FTI.at("whisp");
+    assert(false && "Should have been unreachable.");
+  } catch (const std::out_of_range&) {
+  }
+
+  auto FindWhispy = FTI.find("whispy");
+  assert(FindWhispy != FTI.end() && FindWhispy->first == "whispy" &&
+         FindWhispy->second == 69);
+  assert(FTI.find("Gregorics") == FTI.end());
+
+  std::ostringstream OS;
+  for (const auto& Elem : FTI) {
+    OS << '(' << Elem.first << "->" << Elem.second << "),";
+  }
+  std::string Result = OS.str();
+  Result.pop_back();
+  std::string Expected = "(abel->16),(gs->-24),(gsd->42),(whispy->69),(xazax->1337)";
+  assert(Result == Expected);
+
+  // Walking backwards from the last element.
+  OS.str("");
+  auto It = FTI.find("xazax");
+  for (; It != FTI.end(); --It) {
+    OS << '(' << It->first << "->" << It->second << "),";
+  }
+  Result = OS.str();
+  Result.pop_back();
+  Expected = "(xazax->1337),(whispy->69),(gsd->42),(gs->-24),(abel->16)";
+  assert(Result == Expected);
+
+  // Everything under a prefix, straight from the frozen arrays.
+  auto [PrefixFirst, PrefixLast] = FTI.prefix_range("gs");
+  assert(std::distance(PrefixFirst, PrefixLast) == 2 && PrefixFirst->first == "gs");
+  auto [NoneFirst, NoneLast] = FTI.prefix_range("q");
+  assert(NoneFirst == NoneLast && NoneFirst == FTI.end());
+  int PrefixSum = 0;
+  FTI.for_each_prefix("", [&](int Value) { PrefixSum += Value; });
+  assert(PrefixSum == 42 + 69 + 1337 - 24 + 16);
+
+  // Saved once, then opened without rebuilding anything.
+  const char* Path = "frozen_trie_test.bin";
+  {
+    std::ofstream Out(Path, std::ios::binary);
+    FTI.save(Out);
+  }
+  {
+    auto Mapped = frozen_trie<char, int, decltype(CharToStringConcat)>::open(
+        Path, CharToStringConcat);
+    assert(Mapped.size() == 5 && Mapped.count("gsd") == 1 &&
+           Mapped.count("g") == 0 && Mapped.at("xazax") == 1337);
+    assert(Mapped.memory_usage() < FTI.memory_usage());
+
+    OS.str("");
+    for (const auto& Elem : Mapped) {
+      OS << '(' << Elem.first << "->" << Elem.second << "),";
+    }
+    Result = OS.str();
+    Result.pop_back();
+    assert(Result == "(abel->16),(gs->-24),(gsd->42),(whispy->69),(xazax->1337)");
+
+    auto [MappedFirst, MappedLast] = Mapped.prefix_range("w");
+    assert(std::distance(MappedFirst, MappedLast) == 1 && MappedFirst->second == 69);
+
+    // Copies keep viewing the same mapping.
+    auto Copy = Mapped;
+    assert(Copy.at("abel") == 16);
+  }
+
+  // Headers that don't match their sections are refused, not mapped and read
+  // past. The element count sits at byte 24, the louds bit count at byte 32.
+  std::string Saved;
+  {
+    std::ifstream In(Path, std::ios::binary);
+    Saved.assign(std::istreambuf_iterator<char>(In), std::istreambuf_iterator<char>());
+  }
+  for (std::size_t Field : {24, 32}) {
+    std::string Corrupt = Saved;
+    Corrupt[Field + 1] = '\x7f';
+    {
+      std::ofstream Out(Path, std::ios::binary | std::ios::trunc);
+      Out << Corrupt;
+    }
+    try {
+      frozen_trie<char, int, decltype(CharToStringConcat)>::open(Path, CharToStringConcat);
+      assert(false && "Should have been unreachable.");
+    } catch (const std::runtime_error&) {
+    }
+  }
+  std::remove(Path);
+
+  try {
+    frozen_trie<char, int, decltype(CharToStringConcat)>::open("trie_test.cpp",
+                                                                CharToStringConcat);
+    assert(false && "Should have been unreachable.");
+  } catch (const std::runtime_error&) {
+  }
+
+  // The frozen trie is a snapshot, it doesn't follow the original.
+  GTI.erase("gsd");
+  assert(FTI.count("gsd") == 1);
+
+  return 1;
+}
+
+int generic_radix() {
+  const auto& CharToStringConcat = [](std::string& Seq, char C)
+      -> std::string& {
+    Seq.push_back(C);
+    return Seq;
+  };
+
+  // Same interface, but chains of single child nodes are stored as one edge:
+  /*
+
+abel -> 16
+gs -> -24
+├─ d -> 42
+whispy -> 69
+xazax -> 1337
+
+  */
+  radix_trie<char, int, decltype(CharToStringConcat)> RTI{CharToStringConcat};
+  const decltype(RTI)& cRTI = RTI;
+  assert(RTI.empty() && cRTI.count("whispy") == 0);
+
+  auto InsertGSD = RTI.emplace("gsd", 42);
+  assert(InsertGSD.first->first == "gsd" && InsertGSD.first->second == 42 &&
+         InsertGSD.second == true);
+  RTI.emplace("whispy", 69);
+  RTI.emplace("xazax", 1337);
+  assert(RTI.node_count() == 3);
+
+  // "gs" splits the "gsd" edge.
+  RTI.emplace("gs", -24);
+  RTI.emplace("abel", 16);
+  assert(cRTI.size() == 5 && RTI.node_count() == 5);
+  assert(!RTI.emplace("gs", 0).second && RTI.at("gs") == -24);
+  assert(cRTI.count("g") == 0 && cRTI.count("gsdx") == 0 && cRTI.count("whisp") == 0);
+  assert(cRTI["xazax"].value() == 1337 && !cRTI["xaza"].has_value());
+
+  std::ostringstream OS;
+  for (const decltype(RTI)::value_type& Elem : RTI) {
+    OS << '(' << Elem.first << "->" << Elem.second << "),";
+  }
+  std::string Result = OS.str();
+  Result.pop_back();
+  std::string Expected = "(abel->16),(gs->-24),(gsd->42),(whispy->69),(xazax->1337)";
+  assert(Result == Expected);
+
+  // Erasing "gs" merges the "gs" and "d" edges back.
+  assert(RTI.erase("gs") == 1 && RTI.erase("gs") == 0);
+  assert(RTI.node_count() == 4 && RTI.count("gsd") == 1);
+
+  RTI.erase(RTI.find("abel"));
+  RTI.erase("gsd");
+  RTI.erase("whispy");
+  assert(RTI.size() == 1 && RTI.node_count() == 1 &&
+         RTI.begin()->first == "xazax");
+
+  return 1;
+}
+
+int generic_arena() {
+  using arena_string = std::basic_string<char, std::char_traits<char>,
+                                         arena_allocator<char>>;
+  const auto& CharToArenaStringConcat = [](arena_string& Seq, char C)
+      -> arena_string& {
+    Seq.push_back(C);
+    return Seq;
+  };
+
+  // Node storage goes through _Alloc as well, here a bump allocator that is
+  // released in bulk.
+  using arena_trie = trie<char, int, decltype(CharToArenaStringConcat),
+                          std::less, std::basic_string, std::char_traits,
+                          arena_allocator>;
+  static_assert(std::is_same_v<arena_trie::key_type, arena_string>);
+  static_assert(std::is_same_v<arena_trie::allocator_type,
+                               arena_allocator<char>>);
+
+  arena_trie ATI{CharToArenaStringConcat};
+  const trie_arena* Arena = ATI.get_allocator().arena();
+  assert(Arena != nullptr);
+
+  ATI.emplace("gsd", 42);
+  ATI.emplace("whispy", 69);
+  ATI.emplace("gs", -24);
+  assert(ATI.size() == 3 && ATI.at("whispy") == 69);
+
+  std::ostringstream OS;
+  for (const auto& Elem : ATI) {
+    OS << '(' << Elem.first << "->" << Elem.second << "),";
+  }
+  std::string Result = OS.str();
+  Result.pop_back();
+  assert(Result == "(gs->-24),(gsd->42),(whispy->69)");
+
+  // Clearing drops every node at once and starts over in a new arena.
+  ATI.clear();
+  assert(ATI.empty() && ATI.count("gsd") == 0 && ATI.begin() == ATI.end());
+  assert(ATI.get_allocator().arena() != nullptr);
+
+  ATI.emplace("xazax", 1337);
+  assert(ATI.size() == 1 && ATI.at("xazax") == 1337);
+
+  // The compact variant keeps its nodes and values in the arena it is given.
+  compact_trie<char, int, decltype(CharToArenaStringConcat), std::less,
+               std::basic_string, std::char_traits, arena_allocator>
+      CATI{CharToArenaStringConcat, std::less<char>{},
+           arena_allocator<char>(new trie_arena())};
+  const trie_arena* CompactArena = CATI.get_allocator().arena();
+  assert(CompactArena->reserved() > 0);
+  CATI.emplace("gsd", 42);
+  CATI.emplace("whispy", 69);
+  assert(CATI.get_allocator().arena() == CompactArena && CATI.at("whispy") == 69);
+
+  auto CATICopy = CATI;
+  CATI.clear();
+  assert(CATI.empty() && CATICopy.size() == 2 && CATICopy.at("gsd") == 42);
+
+  return 1;
+}
+
+// Same ordering as std::less, but not std::less, so the trie keeps searching
+// children with lower_bound instead of the packed child keys.
+template <typename T> struct plain_less : std::less<T> {};
+
+template <typename Trie, typename Piece>
+static void fill_wide_nodes(Trie& T, Piece First, int Fanout) {
+  using key_type = typename Trie::key_type;
+  for (int I = 0; I < Fanout; ++I)
+    for (int J = 0; J < Fanout; J += 7)
+      T.emplace(key_type{static_cast<Piece>(First + I),
+                         static_cast<Piece>(First + J)},
+                I * Fanout + J);
+}
+
+int generic_simd() {
+  const auto& CharConcat = [](std::string& Seq, char C) -> std::string& {
+    Seq.push_back(C);
+    return Seq;
+  };
+  const auto& U16Concat = [](std::u16string& Seq, char16_t C)
+      -> std::u16string& {
+    Seq.push_back(C);
+    return Seq;
+  };
+
+  using char_trie = trie<char, int, decltype(CharConcat)>;
+  using plain_char_trie = trie<char, int, decltype(CharConcat), plain_less>;
+  using u16_trie = trie<char16_t, int, decltype(U16Concat)>;
+  static_assert(is_simd_key_piece<char, std::less<char>>::value &&
+                is_simd_key_piece<char16_t, std::less<char16_t>>::value &&
+                !is_simd_key_piece<char32_t, std::less<char32_t>>::value &&
+                !is_simd_key_piece<char, plain_less<char>>::value);
+
+  // Every char value, negative ones included, so nodes span many blocks.
+  char_trie CTI{CharConcat};
+  plain_char_trie PCTI{CharConcat};
+  fill_wide_nodes(CTI, static_cast<char>(-128), 256);
+  fill_wide_nodes(PCTI, static_cast<char>(-128), 256);
+  assert(CTI.size() == PCTI.size());
+
+  for (int I = -128; I < 128; I += 3) {
+    CTI.erase(std::string{static_cast<char>(I), static_cast<char>(I)});
+    PCTI.erase(std::string{static_cast<char>(I), static_cast<char>(I)});
+  }
+  for (int I = -128; I < 128; ++I)
+    for (int J = -128; J < 128; ++J) {
+      std::string Key{static_cast<char>(I), static_cast<char>(J)};
+      assert(CTI.count(Key) == PCTI.count(Key));
+    }
+  assert(std::equal(CTI.cbegin(), CTI.cend(), PCTI.cbegin(), PCTI.cend(),
+                    [](const auto& L, const auto& R) {
+                      return L.first == R.first && L.second == R.second;
+                    }));
+
+  u16_trie UTI{U16Concat};
+  fill_wide_nodes(UTI, u'\x4e00', 40);
+  assert(UTI.at(u"\x4e27\x4e07") == 39 * 40 + 7);
+  assert(UTI.count(u"\x4e28") == 0 && UTI.count(u"\x4e27\x4e08") == 0);
+
+  // Copies and moves carry the child keys along with the children.
+  u16_trie UTICopy = UTI;
+  UTI.erase(u"\x4e27\x4e07");
+  assert(UTICopy.at(u"\x4e27\x4e07") == 39 * 40 + 7);
+  u16_trie UTIMoved = std::move(UTICopy);
+  assert(UTIMoved.count(u"\x4e27\x4e07") == 1 && UTI.count(u"\x4e27\x4e07") == 0);
+
+  return 1;
+}
+
+// Counts node allocations, and fails them on demand
+static std::size_t CountedAllocations = 0;
+static bool FailAllocations = false;
+
+template <typename T> struct counting_allocator {
+  using value_type = T;
+
+  counting_allocator() = default;
+  template <typename U> counting_allocator(const counting_allocator<U>&) {}
+
+  T* allocate(std::size_t N) {
+    if (FailAllocations)
+      throw std::bad_alloc();
+    ++CountedAllocations;
+    return std::allocator<T>().allocate(N);
+  }
+  void deallocate(T* P, std::size_t N) { std::allocator<T>().deallocate(P, N); }
+
+  friend bool operator==(const counting_allocator&, const counting_allocator&) { return true; }
+  friend bool operator!=(const counting_allocator&, const counting_allocator&) { return false; }
+};
+
+int generic_adaptive() {
+  const auto& CharConcat = [](std::string& Seq, char C) -> std::string& {
+    Seq.push_back(C);
+    return Seq;
+  };
+
+  // Same interface, nodes switch layout as their fanout changes.
+  using adaptive_char_trie = adaptive_trie<char, int, decltype(CharConcat)>;
+  adaptive_char_trie ATI{CharConcat};
+  const adaptive_char_trie& cATI = ATI;
+  assert(ATI.empty() && cATI.count("whispy") == 0 && ATI.begin() == ATI.end());
+
+  auto InsertGSD = ATI.emplace("gsd", 42);
+  assert(InsertGSD.first->first == "gsd" && InsertGSD.first->second == 42 &&
+         InsertGSD.second == true);
+  ATI.emplace("whispy", 69);
+  ATI.emplace("xazax", 1337);
+  ATI.emplace("gs", -24);
+  ATI.emplace("abel", 16);
+  assert(cATI.size() == 5 && !ATI.emplace("gs", 0).second &&
+         ATI.at("gs") == -24);
+  assert(cATI.count("g") == 0 && cATI.count("gsdx") == 0 &&
+         cATI["xazax"].value() == 1337 && !cATI["xaza"].has_value());
+  assert(ATI.longest_prefix_match("gsdx")->first == "gsd" &&
+         cATI.longest_prefix_match("g") == cATI.end());
+
+  std::ostringstream OS;
+  for (const adaptive_char_trie::value_type& Elem : ATI) {
+    OS << '(' << Elem.first << "->" << Elem.second << "),";
+  }
+  std::string Result = OS.str();
+  Result.pop_back();
+  assert(Result == "(abel->16),(gs->-24),(gsd->42),(whispy->69),(xazax->1337)");
+  assert((--ATI.find("whispy"))->first == "gsd" &&
+         (--ATI.find("gs"))->first == "abel");
+
+  auto Prefix = cATI.prefix_range("gs");
+  assert(std::distance(Prefix.first, Prefix.second) == 2 &&
+         Prefix.second->first == "whispy");
+
+  // Every char value, negative ones included, takes the root through all
+  // layouts and keeps the order of the generic trie.
+  adaptive_char_trie Wide{CharConcat};
+  trie<char, int, decltype(CharConcat)> Reference{CharConcat};
+  fill_wide_nodes(Wide, static_cast<char>(-128), 256);
+  fill_wide_nodes(Reference, static_cast<char>(-128), 256);
+  auto SameElements = [&] {
+    return Wide.size() == Reference.size() &&
+           std::equal(Wide.cbegin(), Wide.cend(), Reference.cbegin(),
+                      Reference.cend(), [](const auto& L, const auto& R) {
+                        return L.first == R.first && L.second == R.second;
+                      });
+  };
+  assert(SameElements());
+  size_t WideBytes = Wide.memory_usage();
+
+  // Copies are deep, erasing shrinks the nodes back.
+  adaptive_char_trie WideCopy = Wide;
+  for (int I = -128; I < 128; ++I)
+    for (int J = -128; J < 128; J += 7) {
+      std::string Key{static_cast<char>(I), static_cast<char>(J)};
+      if (I % 5 != 0) {
+        Wide.erase(Key);
+        Reference.erase(Key);
+      }
+    }
+  assert(SameElements() && Wide.memory_usage() < WideBytes / 4);
+  assert(WideCopy.size() == 256 * 37 && WideCopy.memory_usage() == WideBytes);
+
+  adaptive_char_trie Moved = std::move(WideCopy);
+  assert(Moved.size() == 256 * 37 && WideCopy.empty());
+  Moved.clear();
+  assert(Moved.empty() && Moved.begin() == Moved.end() &&
+         Moved.memory_usage() == 0);
+  Moved.emplace("", 1);
+  assert(Moved.size() == 1 && Moved.begin()->first.empty());
+
+  // Pruning leaves allocates nothing, nodes that cannot shrink stay larger.
+  const auto& CountedConcat = [](auto& Seq, char C) -> auto& {
+    Seq.push_back(C);
+    return Seq;
+  };
+  using counted_adaptive_trie =
+      adaptive_trie<char, int, decltype(CountedConcat), std::less,
+                    std::basic_string, std::char_traits, counting_allocator>;
+  counted_adaptive_trie Pruned{CountedConcat};
+  Pruned.emplace("ab", 1);
+  Pruned.emplace("ac", 2);
+  std::size_t AllocationsBefore = CountedAllocations;
+  assert(Pruned.erase("ab") == 1 && Pruned.erase("ac") == 1 &&
+         Pruned.empty() && CountedAllocations == AllocationsBefore);
+
+  counted_adaptive_trie Stuck{CountedConcat};
+  adaptive_char_trie Shrunk{CharConcat};
+  fill_wide_nodes(Stuck, static_cast<char>(-128), 256);
+  fill_wide_nodes(Shrunk, static_cast<char>(-128), 256);
+  FailAllocations = true;
+  for (int I = -128; I < 128; ++I)
+    for (int J = -128 + 7; J < 128; J += 7)
+      if (I % 5 != 0) {
+        std::string Key{static_cast<char>(I), static_cast<char>(J)};
+        counted_adaptive_trie::key_type CountedKey{Key.begin(), Key.end()};
+        assert(Stuck.erase(CountedKey) == 1 && Shrunk.erase(Key) == 1);
+      }
+  FailAllocations = false;
+  assert(Stuck.size() == Shrunk.size() &&
+         Stuck.memory_usage() > Shrunk.memory_usage() &&
+         std::equal(Stuck.cbegin(), Stuck.cend(), Shrunk.cbegin(), Shrunk.cend(),
+                    [](const auto& L, const auto& R) {
+                      return std::equal(L.first.begin(), L.first.end(),
+                                        R.first.begin(), R.first.end()) &&
+                             L.second == R.second;
+                    }));
+
+  return 1;
+}
+
+int generic_concurrent() {
+  const auto& CharConcat = [](std::string& Seq, char C) -> std::string& {
+    Seq.push_back(C);
+    return Seq;
+  };
+
+  // Readers get copies of the values, writers publish new versions.
+  concurrent_trie<char, int, decltype(CharConcat)> CTI{CharConcat};
+  assert(CTI.empty() && CTI.count("whispy") == 0 && !CTI.find("").has_value());
+
+  assert(CTI.emplace("gsd", 42) && CTI.emplace("whispy", 69));
+  assert(CTI.emplace("gs", -24) && !CTI.emplace("gs", 0));
+  assert(CTI.size() == 3 && CTI.at("gs") == -24 && CTI.find("gsd").value() == 42);
+  assert(CTI.count("g") == 0 && CTI.count("gsdx") == 0);
+
+  bool Thrown = false;
+  try {
+    CTI.at("whisp");
+  } catch (const std::out_of_range&) {
+    Thrown = true;
+  }
+  assert(Thrown);
+
+  assert(CTI.erase("gs") == 1 && CTI.erase("gs") == 0 && CTI.erase("g") == 0);
+  assert(CTI.at("gsd") == 42 && CTI.erase("gsd") == 1 && CTI.count("gsd") == 0);
+  assert(CTI.emplace("", 1) && CTI.at("") == 1 && CTI.erase("") == 1);
+  assert(CTI.size() == 1 && CTI.at("whispy") == 69);
+
+  // Readers running next to the writer only ever see a key with its own
+  // value, or not at all.
+  std::atomic<bool> Done{false};
+  std::atomic<bool> Consistent{true};
+  std::vector<std::thread> Readers;
+  for (int R = 0; R < 4; ++R)
+    Readers.emplace_back([&] {
+      while (!Done.load())
+        for (int I = 0; I < 200; ++I) {
+          std::optional<int> Value = CTI.find(std::to_string(I));
+          if (Value.has_value() && Value.value() != I)
+            Consistent = false;
+        }
+    });
+
+  for (int Round = 0; Round < 20; ++Round)
+    for (int I = 0; I < 200; ++I) {
+      if ((I + Round) % 3 == 0)
+        CTI.erase(std::to_string(I));
+      else
+        CTI.emplace(std::to_string(I), I);
+    }
+  Done = true;
+  for (auto& Reader : Readers)
+    Reader.join();
+  assert(Consistent.load() && CTI.at("whispy") == 69);
+
+  return 1;
+}
+
+int generic_persistent() {
+  const auto& CharConcat = [](std::string& Seq, char C) -> std::string& {
+    Seq.push_back(C);
+    return Seq;
+  };
+
+  // Updates return new versions, the ones they started from stay as they were.
+  using persistent_char_trie = persistent_trie<char, int, decltype(CharConcat)>;
+  const persistent_char_trie Empty{CharConcat};
+  assert(Empty.empty() && Empty.begin() == Empty.end() && Empty.count("") == 0);
+
+  const persistent_char_trie V1 =
+      Empty.emplace("gsd", 42).emplace("whispy", 69).emplace("xazax", 1337);
+  const persistent_char_trie V2 = V1.emplace("gs", -24).emplace("abel", 16);
+  assert(Empty.empty() && V1.size() == 3 && V2.size() == 5);
+  assert(V1.count("gs") == 0 && V2.at("gs") == -24 && V2["gsd"].value() == 42);
+  assert(V2.count("g") == 0 && V2.count("gsdx") == 0 && !V2["xaza"].has_value());
+
+  // Nothing to change gives back the same version.
+  assert(V2.emplace("gs", 0).shares_root_with(V2) && V2.at("gs") == -24);
+  assert(V2.erase("whisp").shares_root_with(V2));
+
+  auto Dump = [](const persistent_char_trie& Version) {
+    std::ostringstream OS;
+    for (const auto& Elem : Version)
+      OS << '(' << Elem.first << "->" << Elem.second << "),";
+    return OS.str();
+  };
+  assert(Dump(V2) == "(abel->16),(gs->-24),(gsd->42),(whispy->69),(xazax->1337),");
+  assert(V2.find("whispy")->second == 69 && (++V2.find("gs"))->first == "gsd");
+  assert(V2.find("gsdx") == V2.end() && V2.find("g") == V2.end());
+
+  const persistent_char_trie V3 = V2.erase("gs").erase("xazax").insert_or_assign("abel", 17);
+  assert(Dump(V3) == "(abel->17),(gsd->42),(whispy->69),");
+  assert(Dump(V2) == "(abel->16),(gs->-24),(gsd->42),(whispy->69),(xazax->1337),");
+
+  // Erasing everything leaves an empty version, the empty key lives at the root.
+  const persistent_char_trie V4 = V3.erase("abel").erase("gsd").erase("whispy");
+  assert(V4.empty() && V4.begin() == V4.end() && V3.size() == 3);
+  const persistent_char_trie V5 = V4.emplace("", 1).emplace("a", 2);
+  assert(Dump(V5) == "(->1),(a->2)," && Dump(V5.erase("")) == "(a->2),");
+
+  // Iterators outlive the versions they come from and can be assigned.
+  auto Survivor = V2.emplace("zz", 7).find("zz");
+  persistent_char_trie::const_iterator Assigned = V1.begin();
+  Assigned = Survivor;
+  assert(Assigned->first == "zz" && Assigned->second == 7 && ++Assigned == V1.end());
+
+  using copied_concat_trie =
+      persistent_trie<char, int, std::decay_t<decltype(CharConcat)>>;
+  copied_concat_trie::const_iterator Copied =
+      copied_concat_trie{CharConcat}.emplace("gs", 1).emplace("gsd", 2).begin();
+  Copied = std::next(Copied);
+  assert(Copied->first == "gsd" && Copied->second == 2);
+
+  return 1;
+}
+
+int generic_compact() {
+  const auto& CharConcat = [](std::string& Seq, char C) -> std::string& {
+    Seq.push_back(C);
+    return Seq;
+  };
+
+  // Same interface, nodes are 32-bit indices into one array.
+  compact_trie<char, int, decltype(CharConcat)> CTI{CharConcat};
+  const decltype(CTI)& cCTI = CTI;
+  assert(CTI.empty() && CTI.begin() == CTI.end() && cCTI.count("whispy") == 0);
+
+  auto InsertGSD = CTI.emplace("gsd", 42);
+  assert(InsertGSD.first->first == "gsd" && InsertGSD.first->second == 42 &&
+         InsertGSD.second == true);
+  CTI.emplace("whispy", 69);
+  CTI.emplace("xazax", 1337);
+  CTI.emplace("gs", -24);
+  CTI.emplace("abel", 16);
+  assert(cCTI.size() == 5 && CTI.node_count() == 19);
+  assert(!CTI.emplace("gs", 0).second && CTI.at("gs") == -24);
+  assert(cCTI.count("g") == 0 && cCTI.count("gsdx") == 0 && cCTI.count("whisp") == 0);
+  assert(cCTI["xazax"].value() == 1337 && !cCTI["xaza"].has_value());
+
+  std::ostringstream OS;
+  for (const auto& Elem : cCTI)
+    OS << '(' << Elem.first << "->" << Elem.second << "),";
+  assert(OS.str() == "(abel->16),(gs->-24),(gsd->42),(whispy->69),(xazax->1337),");
+
+  bool Thrown = false;
+  try {
+    cCTI.at("whisp");
+  } catch (const std::out_of_range&) {
+    Thrown = true;
+  }
+  assert(Thrown);
+
+  // Siblings move between blocks as they come and go, values follow them.
+  std::vector<std::string> Keys;
+  for (char First = 'z'; First >= 'a'; --First)
+    for (char Second = 'a'; Second <= 'z'; Second += 5)
+      Keys.push_back(std::string{First} + Second);
+  for (std::size_t Index = 0; Index < Keys.size(); ++Index)
+    CTI.emplace(Keys[Index], static_cast<int>(Index));
+  assert(CTI.size() == 5 + Keys.size() && CTI.at("gs") == -24 && CTI.at("xazax") == 1337);
+  for (std::size_t Index = 0; Index < Keys.size(); Index += 2)
+    assert(CTI.erase(Keys[Index]) == 1);
+  for (std::size_t Index = 0; Index < Keys.size(); ++Index)
+    assert(CTI.count(Keys[Index]) == Index % 2);
+  for (std::size_t Index = 1; Index < Keys.size(); Index += 2)
+    assert(CTI.at(Keys[Index]) == static_cast<int>(Index));
+  assert(std::is_sorted(CTI.begin(), CTI.end(), [](const auto& Lhs, const auto& Rhs) {
+    return Lhs.first < Rhs.first;
+  }));
+
+  // Toggling a key at a block boundary moves its siblings once, not every time.
+  {
+    compact_trie<char, int, decltype(CharConcat)> Wide{CharConcat};
+    for (char C = '0'; C < '0' + 64; ++C)
+      Wide.emplace(std::string{C}, C);
+    Wide.emplace(std::string{'0' + 64}, 0);
+    const int* First = &Wide.at("0");
+    for (int Round = 0; Round < 8; ++Round) {
+      assert(Wide.erase(std::string{'0' + 64}) == 1 && &Wide.at("0") == First);
+      assert(Wide.emplace(std::string{'0' + 64}, Round).second && &Wide.at("0") == First);
+    }
+    for (char C = '0' + 64; C >= '0' + 4; --C)
+      Wide.erase(std::string{C});
+    assert(Wide.size() == 4 && Wide.at("3") == '3' && Wide.node_count() == 5);
+  }
+
+  // Copies own their values.
+  auto Copy = CTI;
+  Copy.at("gsd") = 0;
+  assert(CTI.at("gsd") == 42 && Copy.size() == CTI.size());
+
+  for (std::size_t Index = 1; Index < Keys.size(); Index += 2)
+    CTI.erase(Keys[Index]);
+  CTI.erase(CTI.find("abel"));
+  CTI.erase("gsd");
+  CTI.erase("gs");
+  CTI.erase("whispy");
+  assert(CTI.size() == 1 && CTI.node_count() == 6 && CTI.begin()->first == "xazax");
+
+  // Reused blocks keep the trie from growing on churn.
+  std::size_t Bytes = CTI.memory_usage();
+  for (int Round = 0; Round < 4; ++Round) {
+    for (const auto& Key : Keys)
+      CTI.emplace(Key, 1);
+    for (const auto& Key : Keys)
+      CTI.erase(Key);
+  }
+  assert(CTI.size() == 1 && CTI.memory_usage() <= 2 * Bytes + 64 * 1024);
+
+  CTI.emplace("", 7);
+  assert(CTI.begin()->first == "" && CTI.at("") == 7);
+  CTI.clear();
+  assert(CTI.empty() && CTI.node_count() == 1);
+
+  // The generic trie reports what its nodes take too.
+  trie<char, int, decltype(CharConcat)> GTI{CharConcat};
+  std::size_t EmptyBytes = GTI.memory_usage();
+  GTI.emplace("gsd", 42);
+  assert(GTI.memory_usage() >= EmptyBytes + 3 * sizeof(decltype(GTI)::node_type));
+
+  return 1;
+}
+
+int generic_counters() {
+  const auto& CharConcat = [](std::string& Seq, char C) -> std::string& {
+    Seq.push_back(C);
+    return Seq;
+  };
+
+  // Profiled tries count their hot path work per thread.
+  using counted_trie = trie<char, int, decltype(CharConcat), std::less,
+                            std::basic_string, std::char_traits,
+                            std::allocator, thread_trie_counters>;
+  counted_trie CTI{CharConcat};
+  counted_trie::reset_counters();
+
+  CTI.emplace("gsd", 42);
+  auto Counters = counted_trie::counters();
+  assert(Counters.nodes_visited == 3 && Counters.child_insertions == 3 &&
+         Counters.child_comparisons == 0 && Counters.nodes_freed == 0);
+
+  // One lower bound comparison and one equality check per level
+  CTI.emplace("gs", -24);
+  Counters = counted_trie::counters();
+  assert(Counters.nodes_visited == 5 && Counters.child_insertions == 3 &&
+         Counters.child_comparisons == 4);
+
+  counted_trie::reset_counters();
+  assert(CTI.count("gsd") == 1 && counted_trie::counters().nodes_visited == 3);
+  assert(CTI.cbegin()->first == "gs" && counted_trie::counters().key_bytes_traced == 2);
+
+  // Other threads keep their own counts
+  counted_trie::reset_counters();
+  std::size_t OtherVisits = 0;
+  std::thread Other([&] {
+    CTI.count("gs");
+    OtherVisits = counted_trie::counters().nodes_visited;
+  });
+  Other.join();
+  assert(OtherVisits == 2 && counted_trie::counters().nodes_visited == 0);
+
+  // Work done on the pool's threads is counted on the calling one
+  std::vector<std::pair<std::string, int>> Pairs;
+  for (int I = 0; I < 500; ++I)
+    Pairs.emplace_back(std::to_string(I * 7919 % 1000), I);
+  counted_trie Serial{CharConcat}, Parallel{CharConcat};
+  counted_trie::reset_counters();
+  for (const auto& [Key, Value] : Pairs)
+    Serial.emplace(Key, Value);
+  std::size_t SerialInsertions = counted_trie::counters().child_insertions;
+  counted_trie::reset_counters();
+  Parallel.emplace_parallel(Pairs.begin(), Pairs.end(), 4);
+  assert(counted_trie::counters().child_insertions == SerialInsertions &&
+         Parallel.size() == Serial.size());
+  counted_trie::reset_counters();
+
+  CTI.erase("gsd");
+  assert(counted_trie::counters().nodes_freed == 1);
+  CTI.emplace("abel", 16);
+  const frozen_trie<char, int, decltype(CharConcat)> FTI{CTI};
+  assert(FTI.size() == 2 && FTI.at("abel") == 16);
+  CTI.erase("gs");
+  assert(counted_trie::counters().nodes_freed == 3 && CTI.size() == 1);
+
+  // Tries that do not count read zero
+  using plain_trie = trie<char, int, decltype(CharConcat)>;
+  plain_trie PTI{CharConcat};
+  PTI.emplace("gsd", 42);
+  plain_trie::reset_counters();
+  assert(plain_trie::counters().nodes_visited == 0 &&
+         plain_trie::counters().child_insertions == 0);
 
   return 1;
 }
@@ -431,7 +1523,10 @@ int main() {
   int8_t grade = 1;
   if (stupid() && stupid_noncopyable())
     ++grade;
-  if (generic())
+  if (generic() && generic_frozen() && generic_radix() &&
+      generic_arena() && generic_simd() && generic_adaptive() &&
+      generic_concurrent() && generic_persistent() &&
+      generic_compact() && generic_counters())
     ++grade;
   return grade;
 }
\ No newline at end of file